@@ -0,0 +1,517 @@
+/*
+ * fuse-passthrough - sample FUSE server using read/write passthrough
+ *
+ * Mirrors a directory at a mount point, like an emulated sdcard daemon
+ * does.  Files are opened on the lower filesystem, registered with
+ * FUSE_DEV_IOC_PASSTHROUGH_OPEN and handed to the kernel with
+ * FOPEN_PASSTHROUGH, so read, write and mmap of them never
+ * come back to this process.  Without passthrough support in the kernel
+ * the same server falls back to serving READ and WRITE itself.
+ *
+ * It talks to /dev/fuse directly and needs no libfuse.  It is single
+ * threaded, never forgets node IDs and does no permission checking, so
+ * it is only meant for testing.
+ *
+ * Build against the headers of this kernel:
+ *	gcc -Wall -O2 -I<kernel>/usr/include -o fuse-passthrough \
+ *		fuse-passthrough.c
+ *
+ * Usage:
+ *	fuse-passthrough <lower dir> <mount point>
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <linux/fuse.h>
+
+#define MAX_WRITE	(128 * 1024)
+#define BUF_SIZE	(MAX_WRITE + 4096)
+
+static char **nodes;		/* lower path of each node ID */
+static unsigned long nr_nodes;
+static int passthrough;		/* negotiated at INIT */
+static int fuse_fd;
+
+static unsigned long node_get(const char *path)
+{
+	unsigned long i;
+
+	for (i = FUSE_ROOT_ID; i < nr_nodes; i++)
+		if (nodes[i] && !strcmp(nodes[i], path))
+			return i;
+
+	nodes = realloc(nodes, (nr_nodes + 1) * sizeof(*nodes));
+	if (!nodes) {
+		perror("realloc");
+		exit(1);
+	}
+	nodes[nr_nodes] = strdup(path);
+	return nr_nodes++;
+}
+
+static const char *node_path(__u64 nodeid)
+{
+	if (nodeid < FUSE_ROOT_ID || nodeid >= nr_nodes)
+		return NULL;
+	return nodes[nodeid];
+}
+
+static char *child_path(__u64 parent, const char *name)
+{
+	const char *dir = node_path(parent);
+	char *path;
+
+	if (!dir || asprintf(&path, "%s/%s", dir, name) < 0)
+		return NULL;
+	return path;
+}
+
+static void reply(struct fuse_in_header *in, int error, const void *arg,
+		  size_t argsize)
+{
+	struct fuse_out_header out;
+	struct iovec iov[2];
+
+	out.len = sizeof(out) + (error ? 0 : argsize);
+	out.error = error;
+	out.unique = in->unique;
+	iov[0].iov_base = &out;
+	iov[0].iov_len = sizeof(out);
+	iov[1].iov_base = (void *)arg;
+	iov[1].iov_len = error ? 0 : argsize;
+
+	if (writev(fuse_fd, iov, 2) < 0 && errno != ENOENT)
+		perror("writev");
+}
+
+static void fill_attr(struct fuse_attr *attr, const struct stat *st)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = st->st_ino;
+	attr->size = st->st_size;
+	attr->blocks = st->st_blocks;
+	attr->atime = st->st_atime;
+	attr->mtime = st->st_mtime;
+	attr->ctime = st->st_ctime;
+	attr->mode = st->st_mode;
+	attr->nlink = st->st_nlink;
+	attr->uid = st->st_uid;
+	attr->gid = st->st_gid;
+	attr->rdev = st->st_rdev;
+	attr->blksize = st->st_blksize;
+}
+
+static void reply_entry(struct fuse_in_header *in, const char *path)
+{
+	struct fuse_entry_out out;
+	struct stat st;
+
+	if (lstat(path, &st) < 0) {
+		reply(in, -errno, NULL, 0);
+		return;
+	}
+
+	memset(&out, 0, sizeof(out));
+	out.nodeid = node_get(path);
+	out.entry_valid = 1;
+	out.attr_valid = 1;
+	fill_attr(&out.attr, &st);
+	reply(in, 0, &out, sizeof(out));
+}
+
+static void reply_attr(struct fuse_in_header *in, const char *path)
+{
+	struct fuse_attr_out out;
+	struct stat st;
+
+	if (!path || lstat(path, &st) < 0) {
+		reply(in, path ? -errno : -ENOENT, NULL, 0);
+		return;
+	}
+
+	memset(&out, 0, sizeof(out));
+	out.attr_valid = 1;
+	fill_attr(&out.attr, &st);
+	reply(in, 0, &out, sizeof(out));
+}
+
+/* Returns the passthrough id to unregister once the reply is written */
+static int fill_open(struct fuse_open_out *out, int fd)
+{
+	__u32 lower_fd = fd;
+	int id = -1;
+
+	memset(out, 0, sizeof(*out));
+	out->fh = fd;
+	if (passthrough) {
+		id = ioctl(fuse_fd, FUSE_DEV_IOC_PASSTHROUGH_OPEN, &lower_fd);
+		if (id < 0) {
+			perror("FUSE_DEV_IOC_PASSTHROUGH_OPEN");
+		} else {
+			out->open_flags = FOPEN_PASSTHROUGH;
+			out->passthrough_fh = id;
+		}
+	}
+
+	return id;
+}
+
+/* The kernel keeps its own reference to the lower file */
+static void put_passthrough(int id)
+{
+	__u32 passthrough_fh = id;
+
+	if (id >= 0)
+		ioctl(fuse_fd, FUSE_DEV_IOC_PASSTHROUGH_CLOSE, &passthrough_fh);
+}
+
+static void do_setattr(struct fuse_in_header *in, struct fuse_setattr_in *arg)
+{
+	const char *path = node_path(in->nodeid);
+	int err = 0;
+
+	if (!path) {
+		reply(in, -ENOENT, NULL, 0);
+		return;
+	}
+
+	if ((arg->valid & FATTR_MODE) && chmod(path, arg->mode) < 0)
+		err = -errno;
+	if (!err && (arg->valid & FATTR_SIZE) && truncate(path, arg->size) < 0)
+		err = -errno;
+	if (!err && (arg->valid & (FATTR_ATIME | FATTR_MTIME))) {
+		struct timeval tv[2];
+		struct stat st;
+
+		if (lstat(path, &st) < 0) {
+			err = -errno;
+		} else {
+			tv[0].tv_sec = (arg->valid & FATTR_ATIME) ?
+				arg->atime : st.st_atime;
+			tv[1].tv_sec = (arg->valid & FATTR_MTIME) ?
+				arg->mtime : st.st_mtime;
+			tv[0].tv_usec = tv[1].tv_usec = 0;
+			if (utimes(path, tv) < 0)
+				err = -errno;
+		}
+	}
+
+	if (err)
+		reply(in, err, NULL, 0);
+	else
+		reply_attr(in, path);
+}
+
+static void do_readdir(struct fuse_in_header *in, struct fuse_read_in *arg)
+{
+	DIR *dir = (DIR *)(unsigned long)arg->fh;
+	static char buf[BUF_SIZE];
+	size_t size = 0, max = arg->size < BUF_SIZE ? arg->size : BUF_SIZE;
+	struct dirent *de;
+
+	seekdir(dir, arg->offset);
+	while ((de = readdir(dir)) != NULL) {
+		struct fuse_dirent *fde = (struct fuse_dirent *)(buf + size);
+		size_t namelen = strlen(de->d_name);
+		size_t entsize = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + namelen);
+
+		/* the next READDIR continues from the previous offset */
+		if (size + entsize > max)
+			break;
+		fde->ino = de->d_ino;
+		fde->off = telldir(dir);
+		fde->namelen = namelen;
+		fde->type = de->d_type;
+		memcpy(fde->name, de->d_name, namelen);
+		memset(fde->name + namelen, 0, entsize - FUSE_NAME_OFFSET -
+		       namelen);
+		size += entsize;
+	}
+
+	reply(in, 0, buf, size);
+}
+
+static void handle(struct fuse_in_header *in, void *arg)
+{
+	const char *path = node_path(in->nodeid);
+	char *newpath;
+	int fd, id, res;
+
+	switch (in->opcode) {
+	case FUSE_INIT: {
+		struct fuse_init_in *init = arg;
+		struct fuse_init_out out;
+
+		memset(&out, 0, sizeof(out));
+		out.major = FUSE_KERNEL_VERSION;
+		out.minor = FUSE_KERNEL_MINOR_VERSION;
+		out.max_readahead = init->max_readahead;
+		out.flags = init->flags & (FUSE_BIG_WRITES | FUSE_PASSTHROUGH);
+		out.max_write = MAX_WRITE;
+		passthrough = !!(out.flags & FUSE_PASSTHROUGH);
+		fprintf(stderr, "passthrough %s\n",
+			passthrough ? "enabled" : "not supported");
+		reply(in, 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_LOOKUP:
+		newpath = child_path(in->nodeid, arg);
+		if (!newpath) {
+			reply(in, -ENOENT, NULL, 0);
+			break;
+		}
+		reply_entry(in, newpath);
+		free(newpath);
+		break;
+	case FUSE_FORGET:
+	case FUSE_BATCH_FORGET:
+		/* no reply */
+		break;
+	case FUSE_GETATTR:
+		reply_attr(in, path);
+		break;
+	case FUSE_SETATTR:
+		do_setattr(in, arg);
+		break;
+	case FUSE_OPEN: {
+		struct fuse_open_in *open_in = arg;
+		struct fuse_open_out out;
+
+		fd = path ? open(path, open_in->flags) : -1;
+		if (fd < 0) {
+			reply(in, path ? -errno : -ENOENT, NULL, 0);
+			break;
+		}
+		id = fill_open(&out, fd);
+		reply(in, 0, &out, sizeof(out));
+		put_passthrough(id);
+		break;
+	}
+	case FUSE_CREATE: {
+		struct fuse_create_in *create_in = arg;
+		struct {
+			struct fuse_entry_out entry;
+			struct fuse_open_out open;
+		} out;
+		struct stat st;
+
+		newpath = child_path(in->nodeid, (char *)(create_in + 1));
+		fd = newpath ? open(newpath, create_in->flags | O_CREAT,
+				    create_in->mode) : -1;
+		if (fd < 0 || fstat(fd, &st) < 0) {
+			reply(in, newpath ? -errno : -ENOENT, NULL, 0);
+			if (fd >= 0)
+				close(fd);
+			free(newpath);
+			break;
+		}
+		memset(&out, 0, sizeof(out));
+		out.entry.nodeid = node_get(newpath);
+		out.entry.entry_valid = 1;
+		out.entry.attr_valid = 1;
+		fill_attr(&out.entry.attr, &st);
+		id = fill_open(&out.open, fd);
+		reply(in, 0, &out, sizeof(out));
+		put_passthrough(id);
+		free(newpath);
+		break;
+	}
+	case FUSE_READ: {
+		/* Only seen without passthrough */
+		struct fuse_read_in *read_in = arg;
+		static char buf[BUF_SIZE];
+		size_t size = read_in->size < BUF_SIZE ?
+			read_in->size : BUF_SIZE;
+
+		res = pread(read_in->fh, buf, size, read_in->offset);
+		reply(in, res < 0 ? -errno : 0, buf, res < 0 ? 0 : res);
+		break;
+	}
+	case FUSE_WRITE: {
+		/* Only seen without passthrough */
+		struct fuse_write_in *write_in = arg;
+		struct fuse_write_out out;
+
+		res = pwrite(write_in->fh, write_in + 1, write_in->size,
+			     write_in->offset);
+		memset(&out, 0, sizeof(out));
+		out.size = res < 0 ? 0 : res;
+		reply(in, res < 0 ? -errno : 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_FLUSH:
+		reply(in, 0, NULL, 0);
+		break;
+	case FUSE_FSYNC: {
+		struct fuse_fsync_in *fsync_in = arg;
+
+		res = fsync(fsync_in->fh);
+		reply(in, res < 0 ? -errno : 0, NULL, 0);
+		break;
+	}
+	case FUSE_RELEASE: {
+		struct fuse_release_in *release_in = arg;
+
+		close(release_in->fh);
+		reply(in, 0, NULL, 0);
+		break;
+	}
+	case FUSE_OPENDIR: {
+		struct fuse_open_out out;
+		DIR *dir = path ? opendir(path) : NULL;
+
+		if (!dir) {
+			reply(in, path ? -errno : -ENOENT, NULL, 0);
+			break;
+		}
+		memset(&out, 0, sizeof(out));
+		out.fh = (unsigned long)dir;
+		reply(in, 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_READDIR:
+		do_readdir(in, arg);
+		break;
+	case FUSE_RELEASEDIR: {
+		struct fuse_release_in *release_in = arg;
+
+		closedir((DIR *)(unsigned long)release_in->fh);
+		reply(in, 0, NULL, 0);
+		break;
+	}
+	case FUSE_MKDIR: {
+		struct fuse_mkdir_in *mkdir_in = arg;
+
+		newpath = child_path(in->nodeid, (char *)(mkdir_in + 1));
+		if (!newpath || mkdir(newpath, mkdir_in->mode) < 0)
+			reply(in, newpath ? -errno : -ENOENT, NULL, 0);
+		else
+			reply_entry(in, newpath);
+		free(newpath);
+		break;
+	}
+	case FUSE_UNLINK:
+	case FUSE_RMDIR:
+		newpath = child_path(in->nodeid, arg);
+		if (!newpath)
+			res = -ENOENT;
+		else if (in->opcode == FUSE_UNLINK)
+			res = unlink(newpath) < 0 ? -errno : 0;
+		else
+			res = rmdir(newpath) < 0 ? -errno : 0;
+		reply(in, res, NULL, 0);
+		free(newpath);
+		break;
+	case FUSE_RENAME: {
+		struct fuse_rename_in *rename_in = arg;
+		char *oldname = (char *)(rename_in + 1);
+		char *oldpath = child_path(in->nodeid, oldname);
+
+		newpath = child_path(rename_in->newdir,
+				     oldname + strlen(oldname) + 1);
+		if (!oldpath || !newpath)
+			res = -ENOENT;
+		else
+			res = rename(oldpath, newpath) < 0 ? -errno : 0;
+		reply(in, res, NULL, 0);
+		free(oldpath);
+		free(newpath);
+		break;
+	}
+	case FUSE_STATFS: {
+		struct fuse_statfs_out out;
+		struct statfs st;
+
+		if (statfs(nodes[FUSE_ROOT_ID], &st) < 0) {
+			reply(in, -errno, NULL, 0);
+			break;
+		}
+		memset(&out, 0, sizeof(out));
+		out.st.blocks = st.f_blocks;
+		out.st.bfree = st.f_bfree;
+		out.st.bavail = st.f_bavail;
+		out.st.files = st.f_files;
+		out.st.ffree = st.f_ffree;
+		out.st.bsize = st.f_bsize;
+		out.st.namelen = st.f_namelen;
+		out.st.frsize = st.f_bsize;
+		reply(in, 0, &out, sizeof(out));
+		break;
+	}
+	case FUSE_DESTROY:
+		reply(in, 0, NULL, 0);
+		exit(0);
+	default:
+		reply(in, -ENOSYS, NULL, 0);
+		break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static char buf[BUF_SIZE];
+	char opts[128];
+	char lower[PATH_MAX];
+	ssize_t len;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <lower dir> <mount point>\n",
+			argv[0]);
+		return 1;
+	}
+	if (!realpath(argv[1], lower)) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	/* node IDs 0 (invalid) and FUSE_ROOT_ID */
+	nodes = calloc(FUSE_ROOT_ID + 1, sizeof(*nodes));
+	nodes[FUSE_ROOT_ID] = strdup(lower);
+	nr_nodes = FUSE_ROOT_ID + 1;
+
+	fuse_fd = open("/dev/fuse", O_RDWR);
+	if (fuse_fd < 0) {
+		perror("/dev/fuse");
+		return 1;
+	}
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=40000,user_id=%d,group_id=%d,allow_other",
+		 fuse_fd, getuid(), getgid());
+	if (mount("fuse-passthrough", argv[2], "fuse", MS_NOSUID | MS_NODEV,
+		  opts) < 0) {
+		perror("mount");
+		return 1;
+	}
+
+	for (;;) {
+		len = read(fuse_fd, buf, sizeof(buf));
+		if (len < 0) {
+			if (errno == EINTR || errno == ENOENT)
+				continue;
+			if (errno != ENODEV)
+				perror("read");
+			break;
+		}
+		if ((size_t)len < sizeof(struct fuse_in_header))
+			continue;
+		handle((struct fuse_in_header *)buf,
+		       buf + sizeof(struct fuse_in_header));
+	}
+
+	return 0;
+}
@@ -0,0 +1,23 @@
+/*
+ * Interface to the ARM assembler AES routines in aes-armv4.S
+ */
+
+#ifndef ASM_ARM_CRYPTO_AES_GLUE_H
+#define ASM_ARM_CRYPTO_AES_GLUE_H
+
+#include <linux/linkage.h>
+#include <linux/types.h>
+
+#define AES_MAXNR 14
+
+typedef struct {
+	unsigned int rd_key[4 *(AES_MAXNR + 1)];
+	int rounds;
+} AES_KEY;
+
+asmlinkage void AES_encrypt(const u8 *in, u8 *out, AES_KEY *ctx);
+asmlinkage void AES_decrypt(const u8 *in, u8 *out, AES_KEY *ctx);
+asmlinkage int private_AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
+asmlinkage int private_AES_set_encrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
+
+#endif
@@ -0,0 +1,546 @@
+/*
+ * Glue Code for the bit-sliced NEON version of the AES Cipher Algorithm
+ *
+ * The NEON code always works on eight blocks at a time.  Whatever is
+ * left over, CBC encryption and requests that arrive while NEON is not
+ * usable are handed to the ARM assembler code in aes-armv4.S.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/crypto.h>
+#include <linux/string.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/b128ops.h>
+#include <crypto/gf128mul.h>
+#include <asm/neon.h>
+
+#include "aes_glue.h"
+
+#define AESBS_BLOCKS		8
+#define AESBS_CHUNK		(AESBS_BLOCKS * AES_BLOCK_SIZE)
+
+/* 8 bit planes of 16 bytes per round key */
+#define AESBS_RK_SIZE		(8 * AES_BLOCK_SIZE)
+
+asmlinkage void aesbs_encrypt8(u8 *out, const u8 *in, const u8 *rk,
+			       int rounds);
+asmlinkage void aesbs_decrypt8(u8 *out, const u8 *in, const u8 *rk,
+			       int rounds);
+
+struct aesbs_ctx {
+	u8 bs_enc[(AES_MAXNR + 1) * AESBS_RK_SIZE];
+	u8 bs_dec[(AES_MAXNR + 1) * AESBS_RK_SIZE];
+	int rounds;
+	AES_KEY enc_key;
+	AES_KEY dec_key;
+};
+
+struct aesbs_xts_ctx {
+	struct aesbs_ctx key;
+	AES_KEY twkey;
+};
+
+/*
+ * Bit-slice round key @round of @rk.  Plane b holds bit b of each key
+ * byte, in the row-major byte order of the NEON state.  The round keys
+ * that follow an S-box have its 0x63 constant folded in.
+ */
+static void aesbs_convert_key(u8 *out, const struct crypto_aes_ctx *rk,
+			      int round, u8 fold)
+{
+	const u32 *w = rk->key_enc + 4 * round;
+	int b, row, col;
+	u8 k;
+
+	for (b = 0; b < 8; b++)
+		for (row = 0; row < 4; row++)
+			for (col = 0; col < 4; col++) {
+				k = (w[col] >> (8 * row)) ^ fold;
+				*out++ = (k >> b) & 1 ? 0xff : 0;
+			}
+}
+
+static int aesbs_expand_key(struct aesbs_ctx *ctx, const u8 *in_key,
+			    unsigned int key_len)
+{
+	struct crypto_aes_ctx rk;
+	int rounds, i, err;
+
+	err = crypto_aes_expand_key(&rk, in_key, key_len);
+	if (err)
+		return err;
+
+	rounds = 6 + key_len / 4;
+
+	/* encryption uses the round keys in order, decryption reversed */
+	aesbs_convert_key(ctx->bs_enc, &rk, 0, 0);
+	for (i = 1; i <= rounds; i++) {
+		aesbs_convert_key(ctx->bs_enc + i * AESBS_RK_SIZE, &rk,
+				  i, 0x63);
+		aesbs_convert_key(ctx->bs_dec + (i - 1) * AESBS_RK_SIZE, &rk,
+				  rounds + 1 - i, 0x63);
+	}
+	aesbs_convert_key(ctx->bs_dec + rounds * AESBS_RK_SIZE, &rk, 0, 0);
+	ctx->rounds = rounds;
+	memset(&rk, 0, sizeof(rk));
+
+	if (private_AES_set_encrypt_key(in_key, key_len * 8,
+					&ctx->enc_key) == -1)
+		return -EINVAL;
+	/* private_AES_set_decrypt_key expects an encryption key as input */
+	ctx->dec_key = ctx->enc_key;
+	if (private_AES_set_decrypt_key(in_key, key_len * 8,
+					&ctx->dec_key) == -1)
+		return -EINVAL;
+	return 0;
+}
+
+static int aesbs_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			 unsigned int key_len)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	if (aesbs_expand_key(ctx, in_key, key_len)) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int aesbs_xts_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	/* the second half of the key encrypts the tweak */
+	if (key_len % 2 || aesbs_expand_key(&ctx->key, in_key, key_len / 2) ||
+	    private_AES_set_encrypt_key(in_key + key_len / 2, key_len * 4,
+					&ctx->twkey) == -1) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int aesbs_ecb_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, int enc)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_CHUNK);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (nbytes >= AESBS_CHUNK && kernel_neon_usable()) {
+			kernel_neon_begin();
+			do {
+				if (enc)
+					aesbs_encrypt8(d, s, ctx->bs_enc,
+						       ctx->rounds);
+				else
+					aesbs_decrypt8(d, s, ctx->bs_dec,
+						       ctx->rounds);
+				s += AESBS_CHUNK;
+				d += AESBS_CHUNK;
+				nbytes -= AESBS_CHUNK;
+			} while (nbytes >= AESBS_CHUNK);
+			kernel_neon_end();
+		}
+
+		while (nbytes >= AES_BLOCK_SIZE) {
+			if (enc)
+				AES_encrypt(s, d, &ctx->enc_key);
+			else
+				AES_decrypt(s, d, &ctx->dec_key);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+			nbytes -= AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_ecb_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_ecb_crypt(desc, dst, src, nbytes, 1);
+}
+
+static int aesbs_ecb_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_ecb_crypt(desc, dst, src, nbytes, 0);
+}
+
+/* CBC encryption is serial, so there is nothing to bit-slice */
+static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		do {
+			crypto_xor(walk.iv, s, AES_BLOCK_SIZE);
+			AES_encrypt(walk.iv, d, &ctx->enc_key);
+			memcpy(walk.iv, d, AES_BLOCK_SIZE);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+			nbytes -= AES_BLOCK_SIZE;
+		} while (nbytes >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	u8 buf[AESBS_CHUNK];
+	u8 next_iv[AES_BLOCK_SIZE];
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_CHUNK);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (nbytes >= AESBS_CHUNK && kernel_neon_usable()) {
+			kernel_neon_begin();
+			do {
+				/*
+				 * Decrypt aside, the ciphertext is still
+				 * needed for the XOR when working in place.
+				 */
+				aesbs_decrypt8(buf, s, ctx->bs_dec,
+					       ctx->rounds);
+				memcpy(next_iv,
+				       s + AESBS_CHUNK - AES_BLOCK_SIZE,
+				       AES_BLOCK_SIZE);
+				for (i = AESBS_BLOCKS - 1; i > 0; i--)
+					crypto_xor(buf + i * AES_BLOCK_SIZE,
+						   s + (i - 1) * AES_BLOCK_SIZE,
+						   AES_BLOCK_SIZE);
+				crypto_xor(buf, walk.iv, AES_BLOCK_SIZE);
+				memcpy(d, buf, AESBS_CHUNK);
+				memcpy(walk.iv, next_iv, AES_BLOCK_SIZE);
+				s += AESBS_CHUNK;
+				d += AESBS_CHUNK;
+				nbytes -= AESBS_CHUNK;
+			} while (nbytes >= AESBS_CHUNK);
+			kernel_neon_end();
+		}
+
+		while (nbytes >= AES_BLOCK_SIZE) {
+			memcpy(next_iv, s, AES_BLOCK_SIZE);
+			AES_decrypt(s, d, &ctx->dec_key);
+			crypto_xor(d, walk.iv, AES_BLOCK_SIZE);
+			memcpy(walk.iv, next_iv, AES_BLOCK_SIZE);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+			nbytes -= AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_ctr_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	u8 ks[AESBS_CHUNK];
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_CHUNK);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (nbytes >= AESBS_CHUNK && kernel_neon_usable()) {
+			kernel_neon_begin();
+			do {
+				for (i = 0; i < AESBS_BLOCKS; i++) {
+					memcpy(ks + i * AES_BLOCK_SIZE, walk.iv,
+					       AES_BLOCK_SIZE);
+					crypto_inc(walk.iv, AES_BLOCK_SIZE);
+				}
+				aesbs_encrypt8(ks, ks, ctx->bs_enc,
+					       ctx->rounds);
+				crypto_xor(ks, s, AESBS_CHUNK);
+				memcpy(d, ks, AESBS_CHUNK);
+				s += AESBS_CHUNK;
+				d += AESBS_CHUNK;
+				nbytes -= AESBS_CHUNK;
+			} while (nbytes >= AESBS_CHUNK);
+			kernel_neon_end();
+		}
+
+		while (nbytes >= AES_BLOCK_SIZE) {
+			AES_encrypt(walk.iv, ks, &ctx->enc_key);
+			crypto_inc(walk.iv, AES_BLOCK_SIZE);
+			crypto_xor(ks, s, AES_BLOCK_SIZE);
+			memcpy(d, ks, AES_BLOCK_SIZE);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+			nbytes -= AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	/* final partial block */
+	if (walk.nbytes) {
+		AES_encrypt(walk.iv, ks, &ctx->enc_key);
+		crypto_xor(ks, walk.src.virt.addr, walk.nbytes);
+		memcpy(walk.dst.virt.addr, ks, walk.nbytes);
+		crypto_inc(walk.iv, AES_BLOCK_SIZE);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+
+	return err;
+}
+
+static int aesbs_xts_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, int enc)
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct aesbs_ctx *key = &ctx->key;
+	struct blkcipher_walk walk;
+	be128 tweak[AESBS_BLOCKS];
+	u8 buf[AESBS_CHUNK];
+	int err, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AESBS_CHUNK);
+	if (!walk.nbytes)
+		return err;
+
+	/* the tweak is kept aligned here rather than in walk.iv */
+	AES_encrypt(walk.iv, (u8 *)&tweak[0], &ctx->twkey);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (nbytes >= AESBS_CHUNK && kernel_neon_usable()) {
+			kernel_neon_begin();
+			do {
+				for (i = 1; i < AESBS_BLOCKS; i++)
+					gf128mul_x_ble(&tweak[i],
+						       &tweak[i - 1]);
+				memcpy(buf, s, AESBS_CHUNK);
+				crypto_xor(buf, (u8 *)tweak, AESBS_CHUNK);
+				if (enc)
+					aesbs_encrypt8(buf, buf, key->bs_enc,
+						       key->rounds);
+				else
+					aesbs_decrypt8(buf, buf, key->bs_dec,
+						       key->rounds);
+				crypto_xor(buf, (u8 *)tweak, AESBS_CHUNK);
+				memcpy(d, buf, AESBS_CHUNK);
+				gf128mul_x_ble(&tweak[0],
+					       &tweak[AESBS_BLOCKS - 1]);
+				s += AESBS_CHUNK;
+				d += AESBS_CHUNK;
+				nbytes -= AESBS_CHUNK;
+			} while (nbytes >= AESBS_CHUNK);
+			kernel_neon_end();
+		}
+
+		while (nbytes >= AES_BLOCK_SIZE) {
+			memcpy(buf, s, AES_BLOCK_SIZE);
+			crypto_xor(buf, (u8 *)&tweak[0], AES_BLOCK_SIZE);
+			if (enc)
+				AES_encrypt(buf, buf, &key->enc_key);
+			else
+				AES_decrypt(buf, buf, &key->dec_key);
+			crypto_xor(buf, (u8 *)&tweak[0], AES_BLOCK_SIZE);
+			memcpy(d, buf, AES_BLOCK_SIZE);
+			gf128mul_x_ble(&tweak[0], &tweak[0]);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+			nbytes -= AES_BLOCK_SIZE;
+		}
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, 1);
+}
+
+static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, 0);
+}
+
+static struct crypto_alg aesbs_algs[] = { {
+	.cra_name		= "ecb(aes)",
+	.cra_driver_name	= "ecb-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[0].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_ecb_encrypt,
+			.decrypt	= aesbs_ecb_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[1].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_cbc_encrypt,
+			.decrypt	= aesbs_cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[2].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_ctr_crypt,
+			.decrypt	= aesbs_ctr_crypt,
+		},
+	},
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_xts_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[3].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_set_key,
+			.encrypt	= aesbs_xts_encrypt,
+			.decrypt	= aesbs_xts_decrypt,
+		},
+	},
+} };
+
+static int __init aesbs_mod_init(void)
+{
+	int err, i;
+
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	for (i = 0; i < ARRAY_SIZE(aesbs_algs); i++) {
+		err = crypto_register_alg(&aesbs_algs[i]);
+		if (err)
+			goto unregister;
+	}
+	return 0;
+
+unregister:
+	while (--i >= 0)
+		crypto_unregister_alg(&aesbs_algs[i]);
+	return err;
+}
+
+static void __exit aesbs_mod_exit(void)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(aesbs_algs) - 1; i >= 0; i--)
+		crypto_unregister_alg(&aesbs_algs[i]);
+}
+
+/* late, so that a built-in copy runs after the VFP code reports NEON */
+late_initcall(aesbs_mod_init);
+module_exit(aesbs_mod_exit);
+
+MODULE_DESCRIPTION("Bit-sliced AES in ECB/CBC/CTR/XTS modes using NEON");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("ecb(aes)");
+MODULE_ALIAS("cbc(aes)");
+MODULE_ALIAS("ctr(aes)");
+MODULE_ALIAS("xts(aes)");
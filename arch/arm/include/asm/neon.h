@@ -0,0 +1,54 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+/*
+ * Below this many bytes memcpy(), __memzero() and copy_page() keep to
+ * the integer code, as the NEON unit costs a context save and a later
+ * reload trap for the interrupted VFP user.
+ */
+#define NEON_STRING_MIN		2048
+
+#ifndef __ASSEMBLY__
+
+#include <linux/types.h>
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * NEON may only be used in kernel mode between kernel_neon_begin() and
+ * kernel_neon_end(), from process context and without sleeping in
+ * between.  The sections do not nest, and the NEON register contents
+ * do not survive kernel_neon_end().
+ */
+#ifdef CONFIG_KERNEL_MODE_NEON
+extern void kernel_neon_begin(void);
+extern void kernel_neon_end(void);
+extern bool kernel_neon_usable(void);
+#else
+static inline bool kernel_neon_usable(void)
+{
+	return false;
+}
+#endif
+
+#ifdef CONFIG_ARM_NEON_STRING
+/*
+ * The integer routines behind memcpy(), __memzero() and copy_page(),
+ * used below NEON_STRING_MIN and whenever NEON is not usable.
+ */
+extern void *__memcpy_arm(void *dest, const void *src, size_t n);
+extern void __memzero_arm(void *ptr, size_t n);
+extern void __copy_page_arm(void *to, const void *from);
+#endif
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* __ASM_ARM_NEON_H */
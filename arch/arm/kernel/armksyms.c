@@ -20,6 +20,7 @@
 #include <asm/checksum.h>
 #include <asm/system.h>
 #include <asm/ftrace.h>
+#include <asm/neon.h>
 
 /*
  * libgcc functions - functions that are used internally by the
@@ -49,6 +50,9 @@ extern void __aeabi_ulcmp(void);
 
 extern void fpundefinstr(void);
 
+/* called from lib/crc32.c, which may be a module */
+extern void __crc32_neon(void);
+
 
 EXPORT_SYMBOL(__backtrace);
 
@@ -90,6 +94,14 @@ EXPORT_SYMBOL(memcpy);
 EXPORT_SYMBOL(memmove);
 EXPORT_SYMBOL(memchr);
 EXPORT_SYMBOL(__memzero);
+#ifdef CONFIG_ARM_NEON_STRING
+EXPORT_SYMBOL(__memcpy_arm);
+EXPORT_SYMBOL(__memzero_arm);
+EXPORT_SYMBOL(__copy_page_arm);
+#endif
+#ifdef CONFIG_CRC32_NEON
+EXPORT_SYMBOL(__crc32_neon);
+#endif
 
 	/* user mem (segment) */
 EXPORT_SYMBOL(__strnlen_user);
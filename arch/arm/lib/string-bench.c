@@ -0,0 +1,158 @@
+/*
+ *  linux/arch/arm/lib/string-bench.c
+ *
+ *  Bandwidth of the integer and NEON memcpy(), __memzero() and
+ *  copy_page().
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Loading the module runs every routine over a range of block sizes and
+ * source/destination misalignments and logs MB/s for the integer code
+ * ("arm") next to the dispatching entry point ("auto"), which uses NEON
+ * from NEON_STRING_MIN bytes on.  The load then fails on purpose, so
+ * that the module can be inserted again for another run.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include <asm/div64.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+#define BENCH_BYTES	(16 << 20)	/* moved per measurement */
+#define BENCH_MAX	(256 << 10)	/* largest block */
+
+typedef void (*bench_fn)(void *dst, void *src, size_t n);
+
+static void memcpy_arm(void *dst, void *src, size_t n)
+{
+	__memcpy_arm(dst, src, n);
+}
+
+static void memcpy_auto(void *dst, void *src, size_t n)
+{
+	memcpy(dst, src, n);
+}
+
+static void memzero_arm(void *dst, void *src, size_t n)
+{
+	__memzero_arm(dst, n);
+}
+
+static void memzero_auto(void *dst, void *src, size_t n)
+{
+	__memzero(dst, n);
+}
+
+static void copy_page_arm(void *dst, void *src, size_t n)
+{
+	__copy_page_arm(dst, src);
+}
+
+static void copy_page_auto(void *dst, void *src, size_t n)
+{
+	copy_page(dst, src);
+}
+
+static const struct {
+	const char *name;
+	bench_fn arm, dispatch;
+	bool page;
+} bench_funcs[] = {
+	{ "memcpy",	memcpy_arm,	memcpy_auto,	false },
+	{ "memzero",	memzero_arm,	memzero_auto,	false },
+	{ "copy_page",	copy_page_arm,	copy_page_auto,	true },
+};
+
+static const size_t bench_sizes[] = {
+	64, 256, 1024, 2048, 4096, 16384, 65536, BENCH_MAX,
+};
+
+static const struct {
+	unsigned int dst, src;
+} bench_aligns[] = {
+	{ 0, 0 }, { 0, 1 }, { 3, 0 }, { 4, 12 },
+};
+
+/* Returns MB/s */
+static unsigned long bench_rate(bench_fn fn, void *dst, void *src, size_t n)
+{
+	unsigned long loops = max_t(unsigned long, BENCH_BYTES / n, 1);
+	unsigned long i;
+	ktime_t start;
+	u64 ns, bytes;
+
+	fn(dst, src, n);
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		fn(dst, src, n);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	bytes = (u64)loops * n * 1000;
+	do_div(bytes, max_t(u64, ns, 1));
+	cond_resched();
+
+	return bytes;
+}
+
+static int __init string_bench_init(void)
+{
+	void *dst, *src;
+	int f, s, a;
+	int ret = -ENOMEM;
+
+	dst = vmalloc(BENCH_MAX + 64);
+	src = vmalloc(BENCH_MAX + 64);
+	if (!dst || !src)
+		goto out;
+	memset(src, 0x5a, BENCH_MAX + 64);
+	memset(dst, 0xa5, BENCH_MAX + 64);
+
+	printk(KERN_INFO "string_bench: NEON %s, integer below %d bytes\n",
+	       kernel_neon_usable() ? "usable" : "not usable",
+	       NEON_STRING_MIN);
+
+	for (f = 0; f < ARRAY_SIZE(bench_funcs); f++) {
+		if (bench_funcs[f].page) {
+			printk(KERN_INFO "string_bench: %-9s %6lu        "
+			       "arm %5lu MB/s auto %5lu MB/s\n",
+			       bench_funcs[f].name, PAGE_SIZE,
+			       bench_rate(bench_funcs[f].arm, dst, src,
+					  PAGE_SIZE),
+			       bench_rate(bench_funcs[f].dispatch, dst, src,
+					  PAGE_SIZE));
+			continue;
+		}
+
+		for (s = 0; s < ARRAY_SIZE(bench_sizes); s++) {
+			for (a = 0; a < ARRAY_SIZE(bench_aligns); a++) {
+				void *d = dst + bench_aligns[a].dst;
+				void *p = src + bench_aligns[a].src;
+				size_t n = bench_sizes[s];
+
+				printk(KERN_INFO "string_bench: %-9s %6zu "
+				       "+%u/+%u arm %5lu MB/s auto %5lu MB/s\n",
+				       bench_funcs[f].name, n,
+				       bench_aligns[a].dst, bench_aligns[a].src,
+				       bench_rate(bench_funcs[f].arm, d, p, n),
+				       bench_rate(bench_funcs[f].dispatch, d, p, n));
+			}
+		}
+	}
+	ret = -EAGAIN;
+out:
+	vfree(src);
+	vfree(dst);
+	return ret;
+}
+module_init(string_bench_init);
+MODULE_DESCRIPTION("memcpy/memzero/copy_page bandwidth benchmark");
+MODULE_LICENSE("GPL");
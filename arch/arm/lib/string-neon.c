@@ -0,0 +1,70 @@
+/*
+ *  linux/arch/arm/lib/string-neon.c
+ *
+ *  Large memcpy(), __memzero() and copy_page() through NEON.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * memcpy() and __memzero() branch here for blocks of NEON_STRING_MIN
+ * bytes and more, copy_page() always comes here.  The NEON loops move
+ * multiples of 64 bytes, the integer routines do the tails.  Whenever
+ * NEON cannot be used (no NEON in the CPU, VFP support not up yet,
+ * interrupt context or an already open kernel NEON section) the integer
+ * routines do the whole job.
+ */
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include <asm/neon.h>
+#include <asm/page.h>
+
+extern void __memcpy_neon(void *dest, const void *src, size_t n);
+extern void __memzero_neon(void *ptr, size_t n);
+extern void __copy_page_neon(void *to, const void *from);
+
+void *__memcpy_large(void *dest, const void *src, size_t n)
+{
+	size_t bulk = n & ~63;
+
+	if (!kernel_neon_usable())
+		return __memcpy_arm(dest, src, n);
+
+	kernel_neon_begin();
+	__memcpy_neon(dest, src, bulk);
+	kernel_neon_end();
+
+	if (n != bulk)
+		__memcpy_arm(dest + bulk, src + bulk, n - bulk);
+	return dest;
+}
+
+void __memzero_large(void *ptr, size_t n)
+{
+	size_t bulk = n & ~63;
+
+	if (!kernel_neon_usable()) {
+		__memzero_arm(ptr, n);
+		return;
+	}
+
+	kernel_neon_begin();
+	__memzero_neon(ptr, bulk);
+	kernel_neon_end();
+
+	if (n != bulk)
+		__memzero_arm(ptr + bulk, n - bulk);
+}
+
+void copy_page(void *to, const void *from)
+{
+	if (!kernel_neon_usable()) {
+		__copy_page_arm(to, from);
+		return;
+	}
+
+	kernel_neon_begin();
+	__copy_page_neon(to, from);
+	kernel_neon_end();
+}
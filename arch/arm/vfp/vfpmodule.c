@@ -17,8 +17,10 @@
 #include <linux/sched.h>
 #include <linux/smp.h>
 #include <linux/init.h>
+#include <linux/percpu.h>
 
 #include <asm/cputype.h>
+#include <asm/neon.h>
 #include <asm/thread_notify.h>
 #include <asm/vfp.h>
 
@@ -510,6 +512,82 @@ void vfp_flush_hwstate(struct thread_info *thread)
 	put_cpu();
 }
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+static DEFINE_PER_CPU(bool, kernel_neon_busy);
+
+/*
+ * Kernel-side NEON support functions
+ */
+void kernel_neon_begin(void)
+{
+	struct thread_info *thread = current_thread_info();
+	unsigned int cpu;
+	u32 fpexc;
+
+	/*
+	 * Kernel mode NEON is only allowed outside of interrupt context
+	 * with preemption disabled. This will make sure that the kernel
+	 * mode NEON register contents never need to be preserved.
+	 */
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+	BUG_ON(per_cpu(kernel_neon_busy, cpu));
+	per_cpu(kernel_neon_busy, cpu) = true;
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	/*
+	 * Save the userland NEON/VFP state. Under UP, the owner could be a
+	 * task other than 'current'
+	 */
+	if (vfp_current_hw_state[cpu] == &thread->vfpstate) {
+		vfp_save_state(&thread->vfpstate, fpexc);
+#ifdef CONFIG_SMP
+		thread->vfpstate.hard.cpu = cpu;
+#endif
+	}
+#ifndef CONFIG_SMP
+	else if (vfp_current_hw_state[cpu] != NULL)
+		vfp_save_state(vfp_current_hw_state[cpu], fpexc);
+#endif
+	vfp_current_hw_state[cpu] = NULL;
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	unsigned int cpu = smp_processor_id();
+
+	/* Disable the NEON/VFP unit. */
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	per_cpu(kernel_neon_busy, cpu) = false;
+	put_cpu();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+
+/*
+ * Whether the caller may enter a kernel_neon_begin()/kernel_neon_end()
+ * section right now.  Code with a plain ARM fallback (string functions,
+ * crypto called from softirq) should check this first.
+ */
+bool kernel_neon_usable(void)
+{
+	bool busy;
+
+	if (!cpu_has_neon() || in_interrupt())
+		return false;
+
+	busy = get_cpu_var(kernel_neon_busy);
+	put_cpu_var(kernel_neon_busy);
+
+	return !busy;
+}
+EXPORT_SYMBOL(kernel_neon_usable);
+
+#endif /* CONFIG_KERNEL_MODE_NEON */
+
 /*
  * VFP hardware can lose all context when a CPU goes offline.
  * As we will be running in SMP mode with CPU hotplug, we will save the
@@ -167,6 +167,8 @@ static void test_cipher_speed(const char *algo, int enc, unsigned int sec,
 		       PTR_ERR(tfm));
 		return;
 	}
+	printk("using %s\n",
+	       crypto_tfm_alg_driver_name(crypto_blkcipher_tfm(tfm)));
 	desc.tfm = tfm;
 	desc.flags = 0;
 
@@ -28,6 +28,10 @@
 #include <linux/async.h>
 #include <linux/suspend.h>
 #include <linux/timer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 
 #include "../base.h"
 #include "power.h"
@@ -187,6 +191,35 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 	}
 }
 
+/**
+ * dpm_latency_record - Account the duration of a device PM callback phase.
+ * @dev: Device whose callbacks have been executed.
+ * @phase: Phase of the system transition the callbacks belong to.
+ * @calltime: Time the callbacks were started.
+ */
+static void dpm_latency_record(struct device *dev,
+			       enum dpm_latency_phase phase, ktime_t calltime)
+{
+	struct dpm_latency *lat = &dev->power.latency[phase];
+	u64 delta = ktime_to_ns(ktime_sub(ktime_get(), calltime));
+	u64 limit = 10 * NSEC_PER_USEC;
+	int bucket;
+
+	for (bucket = 0; bucket < DPM_LATENCY_BUCKETS - 1; bucket++) {
+		if (delta < limit)
+			break;
+		limit *= 10;
+	}
+	lat->hist[bucket]++;
+
+	if (!lat->count || delta < lat->min_ns)
+		lat->min_ns = delta;
+	if (delta > lat->max_ns)
+		lat->max_ns = delta;
+	lat->total_ns += delta;
+	lat->count++;
+}
+
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
@@ -427,6 +460,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
  */
 static int device_resume_noirq(struct device *dev, pm_message_t state)
 {
+	ktime_t calltime = ktime_get();
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -446,6 +480,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 		error = pm_noirq_op(dev, dev->bus->pm, state);
 	}
 
+	dpm_latency_record(dev, DPM_LATENCY_RESUME_NOIRQ, calltime);
 	TRACE_RESUME(error);
 	return error;
 }
@@ -511,6 +546,7 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
  */
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t calltime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -528,6 +564,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	if (!dev->power.is_suspended)
 		goto Unlock;
 
+	calltime = ktime_get();
+
 	if (dev->pwr_domain) {
 		pm_dev_dbg(dev, state, "power domain ");
 		error = pm_op(dev, &dev->pwr_domain->ops, state);
@@ -563,6 +601,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	}
 
  End:
+	dpm_latency_record(dev, DPM_LATENCY_RESUME, calltime);
 	dev->power.is_suspended = false;
 
  Unlock:
@@ -773,31 +812,25 @@ static pm_message_t resume_event(pm_message_t sleep_state)
  */
 static int device_suspend_noirq(struct device *dev, pm_message_t state)
 {
-	int error;
+	ktime_t calltime = ktime_get();
+	int error = 0;
 
 	if (dev->pwr_domain) {
 		pm_dev_dbg(dev, state, "LATE power domain ");
 		error = pm_noirq_op(dev, &dev->pwr_domain->ops, state);
-		if (error)
-			return error;
 	} else if (dev->type && dev->type->pm) {
 		pm_dev_dbg(dev, state, "LATE type ");
 		error = pm_noirq_op(dev, dev->type->pm, state);
-		if (error)
-			return error;
 	} else if (dev->class && dev->class->pm) {
 		pm_dev_dbg(dev, state, "LATE class ");
 		error = pm_noirq_op(dev, dev->class->pm, state);
-		if (error)
-			return error;
 	} else if (dev->bus && dev->bus->pm) {
 		pm_dev_dbg(dev, state, "LATE ");
 		error = pm_noirq_op(dev, dev->bus->pm, state);
-		if (error)
-			return error;
 	}
 
-	return 0;
+	dpm_latency_record(dev, DPM_LATENCY_SUSPEND_NOIRQ, calltime);
+	return error;
 }
 
 /**
@@ -871,6 +904,7 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
  */
 static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 {
+	ktime_t calltime;
 	int error = 0;
 	struct timer_list timer;
 	struct dpm_drv_wd_data data;
@@ -895,6 +929,8 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 		goto Unlock;
 	}
 
+	calltime = ktime_get();
+
 	if (dev->pwr_domain) {
 		pm_dev_dbg(dev, state, "power domain ");
 		error = pm_op(dev, &dev->pwr_domain->ops, state);
@@ -930,6 +966,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	}
 
  End:
+	dpm_latency_record(dev, DPM_LATENCY_SUSPEND, calltime);
 	dev->power.is_suspended = !error;
 
  Unlock:
@@ -1147,3 +1184,132 @@ int device_pm_wait_for_dev(struct device *subordinate, struct device *dev)
 	return async_error;
 }
 EXPORT_SYMBOL_GPL(device_pm_wait_for_dev);
+
+#ifdef CONFIG_DEBUG_FS
+struct dpm_latency_entry {
+	struct device *dev;
+	enum dpm_latency_phase phase;
+};
+
+static const char * const dpm_latency_phase_names[DPM_LATENCY_PHASES] = {
+	[DPM_LATENCY_SUSPEND]		= "suspend",
+	[DPM_LATENCY_SUSPEND_NOIRQ]	= "suspend_noirq",
+	[DPM_LATENCY_RESUME_NOIRQ]	= "resume_noirq",
+	[DPM_LATENCY_RESUME]		= "resume",
+};
+
+static u64 dpm_latency_entry_cost(const struct dpm_latency_entry *e)
+{
+	return e->dev->power.latency[e->phase].total_ns;
+}
+
+static int dpm_latency_cmp(const void *a, const void *b)
+{
+	u64 cost_a = dpm_latency_entry_cost(a);
+	u64 cost_b = dpm_latency_entry_cost(b);
+
+	if (cost_a == cost_b)
+		return 0;
+	return cost_a < cost_b ? 1 : -1;
+}
+
+static int dpm_latency_add_list(struct dpm_latency_entry *entries, int n,
+				int size, struct list_head *list)
+{
+	struct device *dev;
+	int phase;
+
+	list_for_each_entry(dev, list, power.entry)
+		for (phase = 0; phase < DPM_LATENCY_PHASES; phase++) {
+			if (!dev->power.latency[phase].count)
+				continue;
+			if (n >= size)
+				return n;
+			entries[n].dev = dev;
+			entries[n].phase = phase;
+			n++;
+		}
+	return n;
+}
+
+static int dpm_latency_show(struct seq_file *s, void *data)
+{
+	struct list_head *lists[] = { &dpm_list, &dpm_prepared_list,
+				      &dpm_suspended_list, &dpm_noirq_list };
+	struct dpm_latency_entry *entries;
+	struct device *dev;
+	int i, b, n = 0, size = 0;
+
+	mutex_lock(&dpm_list_mtx);
+
+	for (i = 0; i < ARRAY_SIZE(lists); i++)
+		list_for_each_entry(dev, lists[i], power.entry)
+			size += DPM_LATENCY_PHASES;
+
+	entries = kmalloc(size * sizeof(*entries), GFP_KERNEL);
+	if (!entries) {
+		mutex_unlock(&dpm_list_mtx);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(lists); i++)
+		n = dpm_latency_add_list(entries, n, size, lists[i]);
+
+	sort(entries, n, sizeof(*entries), dpm_latency_cmp, NULL);
+
+	seq_printf(s, "%-24s %-13s %6s %10s %10s %10s %12s  "
+		   "<10us <100us <1ms <10ms <100ms <1s >=1s\n",
+		   "device", "phase", "count", "min(us)", "avg(us)",
+		   "max(us)", "total(us)");
+	for (i = 0; i < n; i++) {
+		struct dpm_latency *lat =
+			&entries[i].dev->power.latency[entries[i].phase];
+		u64 avg = div_u64(lat->total_ns, lat->count);
+
+		seq_printf(s, "%-24s %-13s %6u %10llu %10llu %10llu %12llu ",
+			   dev_name(entries[i].dev),
+			   dpm_latency_phase_names[entries[i].phase],
+			   lat->count,
+			   (unsigned long long)div_u64(lat->min_ns, NSEC_PER_USEC),
+			   (unsigned long long)div_u64(avg, NSEC_PER_USEC),
+			   (unsigned long long)div_u64(lat->max_ns, NSEC_PER_USEC),
+			   (unsigned long long)div_u64(lat->total_ns,
+						       NSEC_PER_USEC));
+		for (b = 0; b < DPM_LATENCY_BUCKETS; b++)
+			seq_printf(s, " %u", lat->hist[b]);
+		seq_putc(s, '\n');
+	}
+
+	mutex_unlock(&dpm_list_mtx);
+	kfree(entries);
+	return 0;
+}
+
+static int dpm_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_latency_show, NULL);
+}
+
+static const struct file_operations dpm_latency_fops = {
+	.open		= dpm_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_latency_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("dpm_latency", 0444, NULL, NULL,
+				&dpm_latency_fops);
+	if (!d) {
+		pr_err("PM: Failed to create dpm_latency debug file\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+late_initcall(dpm_latency_debug_init);
+#endif
@@ -37,6 +37,9 @@
 
 static int active_count;
 
+/* Maximum number of samples per load predictor period. */
+#define PRED_MAX_PERIOD 16
+
 struct cpufreq_interactive_cpuinfo {
 	struct timer_list cpu_timer;
 	struct timer_list cpu_slack_timer;
@@ -53,6 +56,15 @@ struct cpufreq_interactive_cpuinfo {
 	u64 hispeed_validate_time;
 	struct rw_semaphore enable_sem;
 	int governor_enabled;
+	/* load predictor state, only touched from this CPU's timer */
+	unsigned int pred_short;
+	unsigned int pred_long;
+	unsigned int pred_hist[PRED_MAX_PERIOD];
+	unsigned int pred_slot;
+	unsigned int pred_last;
+	bool pred_primed;
+	unsigned long pred_hits;
+	unsigned long pred_misses;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -116,6 +128,35 @@ static int timer_slack_val = DEFAULT_TIMER_SLACK;
 
 static bool io_is_busy;
 
+/*
+ * If non-zero, choose_freq() is fed a blend of the last sample, short
+ * and long term load averages and a per-period load histogram instead
+ * of the load of the last sample alone.
+ */
+static bool predictor_val;
+
+/*
+ * Number of timer_rate samples in one predictor period, i.e. the length
+ * of the periodic (e.g. frame-aligned) demand pattern to track.
+ */
+#define DEFAULT_PRED_PERIOD 4
+static unsigned int pred_period = DEFAULT_PRED_PERIOD;
+
+/* EWMA weights, as shifts: new = old - old / 2^n + sample / 2^n */
+#define PRED_SHORT_SHIFT 1
+#define PRED_LONG_SHIFT 3
+#define PRED_HIST_SHIFT 2
+
+/* Weights of the blended prediction, summing to 1 << PRED_WEIGHT_SHIFT */
+#define PRED_WEIGHT_SHIFT 3
+#define PRED_WEIGHT_LAST 1
+#define PRED_WEIGHT_SHORT 2
+#define PRED_WEIGHT_LONG 1
+#define PRED_WEIGHT_HIST 4
+
+/* A sample within 1 / 2^n of its prediction counts as a hit */
+#define PRED_HIT_SHIFT 3
+
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event);
 
@@ -212,6 +253,13 @@ static void cpufreq_interactive_timer_start(int cpu)
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
 	spin_unlock_irqrestore(&pcpu->load_lock, flags);
+
+	pcpu->pred_short = 0;
+	pcpu->pred_long = 0;
+	memset(pcpu->pred_hist, 0, sizeof(pcpu->pred_hist));
+	pcpu->pred_slot = 0;
+	pcpu->pred_last = 0;
+	pcpu->pred_primed = false;
 }
 
 static unsigned int freq_to_above_hispeed_delay(unsigned int freq)
@@ -338,6 +386,72 @@ static unsigned int choose_freq(
 	return freq;
 }
 
+static inline unsigned int pred_ewma(unsigned int avg, unsigned int sample,
+				     int shift)
+{
+	return (unsigned int)((((u64)avg << shift) - avg + sample) >> shift);
+}
+
+/*
+ * Fold the demand of the sample just taken into the predictor and return
+ * the demand expected over the next sample: a weighted blend of the last
+ * sample, the short and long term averages, and the average demand seen
+ * at the same position in previous periods.  The history slot weighs the
+ * most, so a periodic load is followed down as well as up, and the
+ * prediction can be below the last sample.  choose_freq() then picks the
+ * lowest speed covering that demand.
+ */
+static unsigned int predict_load(struct cpufreq_interactive_cpuinfo *pcpu,
+				 int cpu, unsigned int loadadjfreq)
+{
+	unsigned int period = pred_period;
+	unsigned int slot, pred, err;
+	u64 blend;
+	int i;
+
+	if (period < 1 || period > PRED_MAX_PERIOD)
+		period = DEFAULT_PRED_PERIOD;
+
+	if (pcpu->pred_primed) {
+		err = loadadjfreq > pcpu->pred_last ?
+			loadadjfreq - pcpu->pred_last :
+			pcpu->pred_last - loadadjfreq;
+		if (err <= pcpu->pred_last >> PRED_HIT_SHIFT)
+			pcpu->pred_hits++;
+		else
+			pcpu->pred_misses++;
+	} else {
+		/* start the averages from the first sample, not from zero */
+		pcpu->pred_short = loadadjfreq;
+		pcpu->pred_long = loadadjfreq;
+		for (i = 0; i < PRED_MAX_PERIOD; i++)
+			pcpu->pred_hist[i] = loadadjfreq;
+		pcpu->pred_primed = true;
+	}
+
+	slot = pcpu->pred_slot % period;
+	pcpu->pred_hist[slot] = pred_ewma(pcpu->pred_hist[slot], loadadjfreq,
+					  PRED_HIST_SHIFT);
+	pcpu->pred_short = pred_ewma(pcpu->pred_short, loadadjfreq,
+				     PRED_SHORT_SHIFT);
+	pcpu->pred_long = pred_ewma(pcpu->pred_long, loadadjfreq,
+				    PRED_LONG_SHIFT);
+	pcpu->pred_slot = (slot + 1) % period;
+
+	blend = (u64)loadadjfreq * PRED_WEIGHT_LAST +
+		(u64)pcpu->pred_short * PRED_WEIGHT_SHORT +
+		(u64)pcpu->pred_long * PRED_WEIGHT_LONG +
+		(u64)pcpu->pred_hist[pcpu->pred_slot] * PRED_WEIGHT_HIST;
+	pred = blend >> PRED_WEIGHT_SHIFT;
+
+	trace_cpufreq_interactive_predict(cpu, loadadjfreq, pcpu->pred_short,
+					  pcpu->pred_long,
+					  pcpu->pred_hist[pcpu->pred_slot],
+					  pred);
+	pcpu->pred_last = pred;
+	return pred;
+}
+
 static u64 update_load(int cpu)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
@@ -393,6 +507,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 
 	do_div(cputime_speedadj, delta_time);
 	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	if (predictor_val)
+		loadadjfreq = predict_load(pcpu, data, loadadjfreq);
 	cpu_load = loadadjfreq / pcpu->target_freq;
 	boosted = boost_val || now < boostpulse_endtime;
 
@@ -1022,6 +1138,69 @@ static ssize_t store_io_is_busy(struct kobject *kobj,
 static struct global_attr io_is_busy_attr = __ATTR(io_is_busy, 0644,
 		show_io_is_busy, store_io_is_busy);
 
+static ssize_t show_predictor(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", predictor_val);
+}
+
+static ssize_t store_predictor(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	predictor_val = val;
+	return count;
+}
+
+define_one_global_rw(predictor);
+
+static ssize_t show_predictor_period(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", pred_period);
+}
+
+static ssize_t store_predictor_period(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (val < 1 || val > PRED_MAX_PERIOD)
+		return -EINVAL;
+	pred_period = val;
+	return count;
+}
+
+define_one_global_rw(predictor_period);
+
+static ssize_t show_predictor_stats(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	unsigned int cpu;
+	ssize_t ret = 0;
+
+	for_each_possible_cpu(cpu) {
+		struct cpufreq_interactive_cpuinfo *pcpu =
+			&per_cpu(cpuinfo, cpu);
+
+		ret += sprintf(buf + ret, "cpu%u hits %lu misses %lu\n", cpu,
+			       pcpu->pred_hits, pcpu->pred_misses);
+	}
+
+	return ret;
+}
+
+define_one_global_ro(predictor_stats);
+
 static struct attribute *interactive_attributes[] = {
 	&target_loads_attr.attr,
 	&above_hispeed_delay_attr.attr,
@@ -1034,6 +1213,9 @@ static struct attribute *interactive_attributes[] = {
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
 	&io_is_busy_attr.attr,
+	&predictor.attr,
+	&predictor_period.attr,
+	&predictor_stats.attr,
 	NULL,
 };
 
@@ -20,6 +20,10 @@
 #include <linux/kobject.h>
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
+#include <linux/hash.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/sched.h>
 #include <asm/cputime.h>
 
 static spinlock_t cpufreq_stats_lock;
@@ -51,6 +55,163 @@ struct cpufreq_stats_attribute {
 	ssize_t(*show) (struct cpufreq_stats *, char *);
 };
 
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+/*
+ * Per-uid time in state.  Entries are created on the first tick charged
+ * to a uid and never freed; the table is small (one entry per app uid)
+ * and looked up from the tick, so it is a plain hash under a spinlock.
+ */
+#define UID_HASH_BITS	7
+
+struct uid_entry {
+	uid_t uid;
+	unsigned int max_state;
+	struct hlist_node hash;
+	cputime64_t time_in_state[0];
+};
+
+static struct hlist_head uid_hash_table[1 << UID_HASH_BITS];
+static DEFINE_SPINLOCK(uid_lock);
+static unsigned int uid_max_state;
+
+/*
+ * Copy of the stats last_index for the tick, which can't take
+ * cpufreq_stats_lock and must not look at a table being freed.
+ */
+static DEFINE_PER_CPU(int, uid_last_index) = -1;
+
+static void cpufreq_stats_set_uid_index(unsigned int cpu, int index)
+{
+	per_cpu(uid_last_index, cpu) = index;
+}
+
+static struct uid_entry *find_uid_entry(uid_t uid)
+{
+	struct uid_entry *uid_entry;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(uid_entry, node,
+			     &uid_hash_table[hash_32(uid, UID_HASH_BITS)], hash)
+		if (uid_entry->uid == uid)
+			return uid_entry;
+	return NULL;
+}
+
+static struct uid_entry *find_or_register_uid(uid_t uid)
+{
+	struct uid_entry *uid_entry;
+
+	uid_entry = find_uid_entry(uid);
+	if (uid_entry)
+		return uid_entry;
+
+	if (!uid_max_state)
+		return NULL;
+
+	uid_entry = kzalloc(sizeof(struct uid_entry) +
+			    uid_max_state * sizeof(cputime64_t), GFP_ATOMIC);
+	if (!uid_entry)
+		return NULL;
+
+	uid_entry->uid = uid;
+	uid_entry->max_state = uid_max_state;
+	hlist_add_head(&uid_entry->hash,
+		       &uid_hash_table[hash_32(uid, UID_HASH_BITS)]);
+	return uid_entry;
+}
+
+/*
+ * Called from the scheduler tick accounting with the cpu time just
+ * charged to @p, which is running on the current cpu.  The time goes to
+ * the frequency last reported for this cpu by the transition notifier.
+ */
+void cpufreq_stats_account_uid(struct task_struct *p, cputime_t cputime)
+{
+	struct uid_entry *uid_entry;
+	unsigned long flags;
+	uid_t uid;
+	int index;
+
+	index = ACCESS_ONCE(per_cpu(uid_last_index, smp_processor_id()));
+	if (index < 0)
+		return;
+
+	uid = task_uid(p);
+
+	spin_lock_irqsave(&uid_lock, flags);
+	uid_entry = find_or_register_uid(uid);
+	if (uid_entry && index < uid_entry->max_state)
+		uid_entry->time_in_state[index] =
+			cputime64_add(uid_entry->time_in_state[index],
+				      cputime_to_cputime64(cputime));
+	spin_unlock_irqrestore(&uid_lock, flags);
+}
+
+static int uid_time_in_state_show(struct seq_file *m, void *v)
+{
+	struct cpufreq_stats *stat = NULL;
+	struct uid_entry *uid_entry;
+	struct hlist_node *node;
+	unsigned long flags;
+	unsigned int cpu, state_num;
+	int i, bkt;
+
+	/* cpufreq_stats_free_table() unhooks the table under this lock */
+	spin_lock(&cpufreq_stats_lock);
+	for_each_possible_cpu(cpu) {
+		stat = per_cpu(cpufreq_stats_table, cpu);
+		if (stat)
+			break;
+	}
+	if (!stat) {
+		spin_unlock(&cpufreq_stats_lock);
+		return 0;
+	}
+
+	state_num = stat->state_num;
+	seq_puts(m, "uid:");
+	for (i = 0; i < state_num; i++)
+		seq_printf(m, " %u", stat->freq_table[i]);
+	seq_putc(m, '\n');
+	spin_unlock(&cpufreq_stats_lock);
+
+	spin_lock_irqsave(&uid_lock, flags);
+	for (bkt = 0; bkt < ARRAY_SIZE(uid_hash_table); bkt++) {
+		hlist_for_each_entry(uid_entry, node, &uid_hash_table[bkt],
+				     hash) {
+			seq_printf(m, "%d:", uid_entry->uid);
+			for (i = 0; i < state_num; i++) {
+				cputime64_t time = 0;
+
+				if (i < uid_entry->max_state)
+					time = uid_entry->time_in_state[i];
+				seq_printf(m, " %llu", (unsigned long long)
+					   cputime64_to_clock_t(time));
+			}
+			seq_putc(m, '\n');
+		}
+	}
+	spin_unlock_irqrestore(&uid_lock, flags);
+	return 0;
+}
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_time_in_state_show, NULL);
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#else
+static void cpufreq_stats_set_uid_index(unsigned int cpu, int index)
+{
+}
+#endif /* CONFIG_CPU_FREQ_STAT_UID */
+
 static int cpufreq_stats_update(unsigned int cpu)
 {
 	struct cpufreq_stats *stat;
@@ -170,12 +331,17 @@ static int freq_table_get_index(struct cpufreq_stats *stat, unsigned int freq)
  */
 static void cpufreq_stats_free_table(unsigned int cpu)
 {
-	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, cpu);
+	struct cpufreq_stats *stat;
+
+	cpufreq_stats_set_uid_index(cpu, -1);
+	spin_lock(&cpufreq_stats_lock);
+	stat = per_cpu(cpufreq_stats_table, cpu);
+	per_cpu(cpufreq_stats_table, cpu) = NULL;
+	spin_unlock(&cpufreq_stats_lock);
 	if (stat) {
 		kfree(stat->time_in_state);
 		kfree(stat);
 	}
-	per_cpu(cpufreq_stats_table, cpu) = NULL;
 }
 
 /* must be called early in the CPU removal sequence (before
@@ -249,9 +415,16 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 			stat->freq_table[j++] = freq;
 	}
 	stat->state_num = j;
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+	spin_lock_irq(&uid_lock);
+	if (j > uid_max_state)
+		uid_max_state = j;
+	spin_unlock_irq(&uid_lock);
+#endif
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_time = get_jiffies_64();
 	stat->last_index = freq_table_get_index(stat, policy->cur);
+	cpufreq_stats_set_uid_index(cpu, stat->last_index);
 	spin_unlock(&cpufreq_stats_lock);
 	cpufreq_cpu_put(data);
 	return 0;
@@ -309,6 +482,7 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_index = new_index;
+	cpufreq_stats_set_uid_index(freq->cpu, new_index);
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stat->trans_table[old_index * stat->max_state + new_index]++;
 #endif
@@ -402,6 +576,10 @@ static int __init cpufreq_stats_init(void)
 	for_each_online_cpu(cpu) {
 		cpufreq_update_policy(cpu);
 	}
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+	proc_create("uid_time_in_state", S_IRUGO, NULL,
+		    &uid_time_in_state_fops);
+#endif
 	return 0;
 }
 static void __exit cpufreq_stats_exit(void)
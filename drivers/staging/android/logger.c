@@ -64,6 +64,68 @@ struct logger_reader {
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 #define logger_offset(n)	((n) & (log->size - 1))
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER
+extern void ram_console_log_write(const char *s, unsigned int count);
+
+/* ram_console_mutex protects the two buffers below */
+static DEFINE_MUTEX(ram_console_mutex);
+static char ram_console_payload[LOGGER_ENTRY_MAX_PAYLOAD + 1];
+static char ram_console_line[LOGGER_ENTRY_MAX_PAYLOAD + 64];
+
+/*
+ * copy_to_ram_console - appends the entry just written at offset 'off' to
+ * the RAM console as one "[time] log P/tag(pid): message" line, so that
+ * last_kmsg also shows what userspace logged before a reset.  The events
+ * log is binary and is left out.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void copy_to_ram_console(struct logger_log *log,
+				struct logger_entry *header, size_t off)
+{
+	static const char prio_chars[] = "??VDIWEFS";
+	char *payload = ram_console_payload;
+	unsigned long long t = local_clock();
+	unsigned long nsec;
+	size_t len = header->len, first;
+	unsigned char prio;
+	char *tag, *msg, *end;
+	int n;
+
+	if (!strcmp(log->misc.name, LOGGER_LOG_EVENTS))
+		return;
+
+	mutex_lock(&ram_console_mutex);
+
+	/* the payload may wrap around the end of the log */
+	off = logger_offset(off + sizeof(struct logger_entry));
+	first = min(len, log->size - off);
+	memcpy(payload, log->buffer + off, first);
+	memcpy(payload + first, log->buffer, len - first);
+	payload[len] = '\0';
+
+	/* <priority:1><tag:N>\0<message:N>\0 */
+	prio = payload[0];
+	tag = payload + 1;
+	msg = tag + strlen(tag);
+	if (msg < payload + len)
+		msg++;
+	end = msg + strlen(msg);
+	while (end > msg && end[-1] == '\n')
+		*--end = '\0';
+
+	nsec = do_div(t, 1000000000);
+	n = scnprintf(ram_console_line, sizeof(ram_console_line),
+		      "[%5lu.%06lu] %s %c/%s(%d): %s\n",
+		      (unsigned long)t, nsec / 1000, log->misc.name,
+		      prio < sizeof(prio_chars) - 1 ? prio_chars[prio] : '?',
+		      tag, header->pid, msg);
+	ram_console_log_write(ram_console_line, n);
+
+	mutex_unlock(&ram_console_mutex);
+}
+#endif
+
 /*
  * file_get_log - Given a file structure, return the associated log
  *
@@ -469,6 +531,9 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		ret += nr;
 	}
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER
+	copy_to_ram_console(log, &header, orig);
+#endif
 	mutex_unlock(&log->mutex);
 
 	/* wake up any blocked readers */
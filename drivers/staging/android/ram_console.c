@@ -45,6 +45,10 @@ static size_t ram_console_old_log_size;
 
 static struct ram_console_buffer *ram_console_buffer;
 static size_t ram_console_buffer_size;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER
+/* Console writes hold console_sem, logger ones do not */
+static DEFINE_SPINLOCK(ram_console_lock);
+#endif
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 static char *ram_console_par_buffer;
 static struct rs_control *ram_console_rs_decoder;
@@ -79,27 +83,47 @@ static int ram_console_decode_rs8(void *data, size_t len, uint8_t *ecc)
 }
 #endif
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+static void ram_console_encode_block(size_t offset)
+{
+	size_t size = ECC_BLOCK_SIZE;
+
+	if (offset + size > ram_console_buffer_size)
+		size = ram_console_buffer_size - offset;
+	ram_console_encode_rs8(ram_console_buffer->data + offset, size,
+			       ram_console_par_buffer +
+			       (offset / ECC_BLOCK_SIZE) * ECC_SIZE);
+}
+
+/*
+ * Encode the block that is still being filled.  This happens on oops,
+ * panic, reboot and during boot, so that everything written then is
+ * protected; otherwise the block is encoded once it is full.
+ */
+static void ram_console_flush_ecc(void)
+{
+	size_t start = ram_console_buffer->start;
+
+	if (start % ECC_BLOCK_SIZE)
+		ram_console_encode_block(start & ~(ECC_BLOCK_SIZE - 1));
+}
+#endif
+
 static void ram_console_update(const char *s, unsigned int count)
 {
 	struct ram_console_buffer *buffer = ram_console_buffer;
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	uint8_t *buffer_end = buffer->data + ram_console_buffer_size;
-	uint8_t *block;
-	uint8_t *par;
-	int size = ECC_BLOCK_SIZE;
+	size_t block = buffer->start & ~(ECC_BLOCK_SIZE - 1);
+	size_t end = buffer->start + count;
 #endif
 	memcpy(buffer->data + buffer->start, s, count);
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
-	block = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
-	par = ram_console_par_buffer +
-	      (buffer->start / ECC_BLOCK_SIZE) * ECC_SIZE;
-	do {
-		if (block + ECC_BLOCK_SIZE > buffer_end)
-			size = buffer_end - block;
-		ram_console_encode_rs8(block, size, par);
+	/* only encode the blocks this write completes */
+	while (block + ECC_BLOCK_SIZE <= end ||
+	       (end == ram_console_buffer_size && block < end)) {
+		ram_console_encode_block(block);
 		block += ECC_BLOCK_SIZE;
-		par += ECC_SIZE;
-	} while (block < buffer->data + buffer->start + count);
+	}
 #endif
 }
 
@@ -114,8 +138,7 @@ static void ram_console_update_header(void)
 #endif
 }
 
-static void
-ram_console_write(struct console *console, const char *s, unsigned int count)
+static void __ram_console_write(const char *s, unsigned int count)
 {
 	int rem;
 	struct ram_console_buffer *buffer = ram_console_buffer;
@@ -137,9 +160,33 @@ ram_console_write(struct console *console, const char *s, unsigned int count)
 	buffer->start += count;
 	if (buffer->size < ram_console_buffer_size)
 		buffer->size += count;
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
+	if (unlikely(oops_in_progress || system_state != SYSTEM_RUNNING))
+		ram_console_flush_ecc();
+#endif
 	ram_console_update_header();
 }
 
+static void
+ram_console_write(struct console *console, const char *s, unsigned int count)
+{
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER
+	unsigned long flags;
+	int locked = 1;
+
+	/* the oops may have hit the logger copy, write anyway then */
+	if (unlikely(oops_in_progress))
+		locked = spin_trylock_irqsave(&ram_console_lock, flags);
+	else
+		spin_lock_irqsave(&ram_console_lock, flags);
+	__ram_console_write(s, count);
+	if (locked)
+		spin_unlock_irqrestore(&ram_console_lock, flags);
+#else
+	__ram_console_write(s, count);
+#endif
+}
+
 static struct console ram_console = {
 	.name	= "ram",
 	.write	= ram_console_write,
@@ -147,6 +194,22 @@ static struct console ram_console = {
 	.index	= -1,
 };
 
+#ifdef CONFIG_ANDROID_RAM_CONSOLE_LOGGER
+/* Called by the logger driver with one line per log entry */
+void ram_console_log_write(const char *s, unsigned int count)
+{
+	unsigned long flags;
+
+	if (!ram_console_buffer || !(ram_console.flags & CON_ENABLED))
+		return;
+
+	spin_lock_irqsave(&ram_console_lock, flags);
+	__ram_console_write(s, count);
+	spin_unlock_irqrestore(&ram_console_lock, flags);
+}
+EXPORT_SYMBOL(ram_console_log_write);
+#endif
+
 void ram_console_enable_console(int enabled)
 {
 	if (enabled)
@@ -168,9 +231,20 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 #ifdef CONFIG_ANDROID_RAM_CONSOLE_ERROR_CORRECTION
 	uint8_t *block;
 	uint8_t *par;
+	uint8_t *tail;
+	uint8_t tailbuf[ECC_BLOCK_SIZE];
 	char strbuf[80];
 	int strbuf_len = 0;
 
+	/*
+	 * The block that was being filled is only encoded when it fills
+	 * up or on oops, panic and reboot, so after any other reset its
+	 * parity may be stale.  Check it on a copy and never count it.
+	 */
+	tail = NULL;
+	if (buffer->start % ECC_BLOCK_SIZE)
+		tail = buffer->data + (buffer->start & ~(ECC_BLOCK_SIZE - 1));
+
 	block = buffer->data;
 	par = ram_console_par_buffer;
 	while (block < buffer->data + buffer->size) {
@@ -178,7 +252,15 @@ ram_console_save_old(struct ram_console_buffer *buffer, const char *bootinfo,
 		int size = ECC_BLOCK_SIZE;
 		if (block + size > buffer->data + ram_console_buffer_size)
 			size = buffer->data + ram_console_buffer_size - block;
-		numerr = ram_console_decode_rs8(block, size, par);
+		if (block == tail) {
+			memcpy(tailbuf, block, size);
+			numerr = ram_console_decode_rs8(tailbuf, size, par);
+			if (numerr)
+				printk(KERN_INFO "ram_console: last block "
+				       "was not flushed\n");
+			numerr = 0;
+		} else
+			numerr = ram_console_decode_rs8(block, size, par);
 		if (numerr > 0) {
 #if 0
 			printk(KERN_INFO "ram_console: error in block %p, %d\n",
@@ -26,11 +26,14 @@
 #include <linux/types.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
 
 #define ADB_BULK_BUFFER_SIZE           4096
 
 /* number of tx requests to allocate */
-#define TX_REQ_MAX 4
+#define TX_REQ_MAX 16
 
 static const char adb_shortname[] = "android_adb";
 
@@ -264,48 +267,37 @@ fail:
 	return -1;
 }
 
-static ssize_t adb_read(struct file *fp, char __user *buf,
-				size_t count, loff_t *pos)
+/*
+ * Receive one transfer of up to count bytes from the host into buf,
+ * which must be DMA-able.  Called with read_excl held, returns the
+ * number of bytes received.
+ */
+static int adb_receive(struct adb_dev *dev, void *buf, size_t count)
 {
-	struct adb_dev *dev = fp->private_data;
-	struct usb_request *req;
-	int r = count, xfer;
+	struct usb_request *req = dev->rx_req;
+	void *req_buf = req->buf;
 	int ret;
 
-	pr_debug("adb_read(%d)\n", count);
-	if (!_adb_dev)
-		return -ENODEV;
-
-	if (count > ADB_BULK_BUFFER_SIZE)
-		return -EINVAL;
-
-	if (adb_lock(&dev->read_excl))
-		return -EBUSY;
-
 	/* we will block until we're online */
 	while (!(dev->online || dev->error)) {
 		pr_debug("adb_read: waiting for online state\n");
 		ret = wait_event_interruptible(dev->read_wq,
 				(dev->online || dev->error));
-		if (ret < 0) {
-			adb_unlock(&dev->read_excl);
+		if (ret < 0)
 			return ret;
-		}
-	}
-	if (dev->error) {
-		r = -EIO;
-		goto done;
 	}
+	if (dev->error)
+		return -EIO;
 
+	req->buf = buf;
 requeue_req:
 	/* queue a request */
-	req = dev->rx_req;
 	req->length = count;
 	dev->rx_done = 0;
 	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
 	if (ret < 0) {
 		pr_debug("adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
+		ret = -EIO;
 		dev->error = 1;
 		goto done;
 	} else {
@@ -316,8 +308,12 @@ requeue_req:
 	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
 	if (ret < 0) {
 		dev->error = 1;
-		r = ret;
 		usb_ep_dequeue(dev->ep_out, req);
+		/*
+		 * Some controllers only give the request back later, and
+		 * until then they may still be writing into buf.
+		 */
+		wait_event(dev->read_wq, dev->rx_done);
 		goto done;
 	}
 	if (!dev->error) {
@@ -326,14 +322,37 @@ requeue_req:
 			goto requeue_req;
 
 		pr_debug("rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
-			r = -EFAULT;
-
+		ret = req->actual;
 	} else
-		r = -EIO;
+		ret = -EIO;
 
 done:
+	req->buf = req_buf;
+	return ret;
+}
+
+static ssize_t adb_read(struct file *fp, char __user *buf,
+				size_t count, loff_t *pos)
+{
+	struct adb_dev *dev = fp->private_data;
+	int r = count, xfer;
+
+	pr_debug("adb_read(%d)\n", count);
+	if (!_adb_dev)
+		return -ENODEV;
+
+	if (count > ADB_BULK_BUFFER_SIZE)
+		return -EINVAL;
+
+	if (adb_lock(&dev->read_excl))
+		return -EBUSY;
+
+	xfer = adb_receive(dev, dev->rx_req->buf, count);
+	if (xfer < 0)
+		r = xfer;
+	else if (copy_to_user(buf, dev->rx_req->buf, min_t(int, xfer, count)))
+		r = -EFAULT;
+
 	adb_unlock(&dev->read_excl);
 	pr_debug("adb_read returning %d\n", r);
 	return r;
@@ -406,6 +425,224 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+static const struct pipe_buf_operations adb_pipe_buf_ops = {
+	.can_merge = 0,
+	.map = generic_pipe_buf_map,
+	.unmap = generic_pipe_buf_unmap,
+	.confirm = generic_pipe_buf_confirm,
+	.release = generic_pipe_buf_release,
+	.steal = generic_pipe_buf_steal,
+	.get = generic_pipe_buf_get,
+};
+
+static void adb_spd_release_page(struct splice_pipe_desc *spd, unsigned int i)
+{
+	put_page(spd->pages[i]);
+}
+
+/*
+ * Data taken from the host can't be given back, so make sure the pipe
+ * has room for it before asking for any.  We hold read_excl, so only
+ * another writer of the same pipe could take that room again.
+ */
+static int adb_splice_wait_space(struct pipe_inode_info *pipe,
+				 unsigned int flags)
+{
+	int ret = 0;
+
+	pipe_lock(pipe);
+	for (;;) {
+		if (!pipe->readers) {
+			send_sig(SIGPIPE, current, 0);
+			ret = -EPIPE;
+			break;
+		}
+		if (pipe->nrbufs < pipe->buffers)
+			break;
+		if (flags & SPLICE_F_NONBLOCK) {
+			ret = -EAGAIN;
+			break;
+		}
+		if (signal_pending(current)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		pipe->waiting_writers++;
+		pipe_wait(pipe);
+		pipe->waiting_writers--;
+	}
+	pipe_unlock(pipe);
+
+	return ret;
+}
+
+/*
+ * Receive straight into a page and hand that page over to the pipe, so
+ * the data is never copied on its way to a file spliced from the pipe.
+ */
+static ssize_t adb_splice_read(struct file *fp, loff_t *ppos,
+		struct pipe_inode_info *pipe, size_t len, unsigned int flags)
+{
+	struct adb_dev *dev = fp->private_data;
+	struct page *page;
+	struct partial_page partial;
+	struct splice_pipe_desc spd = {
+		.pages = &page,
+		.partial = &partial,
+		.nr_pages = 1,
+		.nr_pages_max = 1,
+		.flags = flags,
+		.ops = &adb_pipe_buf_ops,
+		.spd_release = adb_spd_release_page,
+	};
+	ssize_t r;
+	int xfer;
+
+	pr_debug("adb_splice_read(%d)\n", len);
+	if (!_adb_dev)
+		return -ENODEV;
+
+	if (len > ADB_BULK_BUFFER_SIZE)
+		len = ADB_BULK_BUFFER_SIZE;
+
+	if (adb_lock(&dev->read_excl))
+		return -EBUSY;
+
+	r = adb_splice_wait_space(pipe, flags);
+	if (r < 0)
+		goto done;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		r = -ENOMEM;
+		goto done;
+	}
+
+	xfer = adb_receive(dev, page_address(page), len);
+	if (xfer < 0) {
+		put_page(page);
+		r = xfer;
+		goto done;
+	}
+
+	partial.offset = 0;
+	partial.len = xfer;
+	partial.private = 0;
+	r = splice_to_pipe(pipe, &spd);
+	/* the data can't be given back to the host, so the stream is broken */
+	if (r < 0)
+		dev->error = 1;
+
+done:
+	adb_unlock(&dev->read_excl);
+	pr_debug("adb_splice_read returning %d\n", r);
+	return r;
+}
+
+/* tx request being filled from a pipe by adb_splice_write() */
+struct adb_splice_out {
+	struct adb_dev *dev;
+	struct usb_request *req;
+};
+
+static int adb_splice_queue(struct adb_dev *dev, struct usb_request *req)
+{
+	int ret;
+
+	ret = usb_ep_queue(dev->ep_in, req, GFP_ATOMIC);
+	if (ret < 0) {
+		pr_debug("adb_splice_write: xfer error %d\n", ret);
+		dev->error = 1;
+		adb_req_put(dev, &dev->tx_idle, req);
+		return -EIO;
+	}
+	return 0;
+}
+
+/* copy a pipe buffer into tx requests, queueing each one once it is full */
+static int adb_pipe_to_req(struct pipe_inode_info *pipe,
+		struct pipe_buffer *buf, struct splice_desc *sd)
+{
+	struct adb_splice_out *out = sd->u.data;
+	struct adb_dev *dev = out->dev;
+	struct usb_request *req = out->req;
+	unsigned int len;
+	void *src;
+	int ret;
+
+	if (!req) {
+		if (dev->error)
+			return -EIO;
+
+		/* get an idle tx request to use */
+		ret = wait_event_interruptible(dev->write_wq,
+			(req = adb_req_get(dev, &dev->tx_idle)) || dev->error);
+		if (!req)
+			return ret < 0 ? ret : -EIO;
+		req->length = 0;
+		out->req = req;
+	}
+
+	len = min_t(unsigned int, sd->len, ADB_BULK_BUFFER_SIZE - req->length);
+	src = buf->ops->map(pipe, buf, 0);
+	memcpy(req->buf + req->length, src + buf->offset, len);
+	buf->ops->unmap(pipe, buf, src);
+	req->length += len;
+
+	if (req->length == ADB_BULK_BUFFER_SIZE) {
+		out->req = NULL;
+		ret = adb_splice_queue(dev, req);
+		if (ret < 0)
+			return ret;
+	}
+	return len;
+}
+
+/*
+ * Each splice is sent like a single write(): the data is packed into
+ * as few requests as possible and the last one is queued short.
+ */
+static ssize_t adb_splice_write(struct pipe_inode_info *pipe, struct file *fp,
+		loff_t *ppos, size_t len, unsigned int flags)
+{
+	struct adb_dev *dev = fp->private_data;
+	struct adb_splice_out out = {
+		.dev = dev,
+	};
+	struct splice_desc sd = {
+		.total_len = len,
+		.flags = flags,
+		.u.data = &out,
+	};
+	ssize_t r;
+	int ret;
+
+	pr_debug("adb_splice_write(%d)\n", len);
+	if (!_adb_dev)
+		return -ENODEV;
+
+	if (adb_lock(&dev->write_excl))
+		return -EBUSY;
+
+	pipe_lock(pipe);
+	r = __splice_from_pipe(pipe, &sd, adb_pipe_to_req);
+	pipe_unlock(pipe);
+
+	if (out.req) {
+		if (out.req->length) {
+			ret = adb_splice_queue(dev, out.req);
+			if (ret < 0)
+				r = ret;
+		} else {
+			adb_req_put(dev, &dev->tx_idle, out.req);
+		}
+	}
+
+	adb_unlock(&dev->write_excl);
+	pr_debug("adb_splice_write returning %d\n", r);
+	return r;
+}
+
 static int adb_open(struct inode *ip, struct file *fp)
 {
 	pr_info("adb_open\n");
@@ -440,6 +677,8 @@ static struct file_operations adb_fops = {
 	.owner = THIS_MODULE,
 	.read = adb_read,
 	.write = adb_write,
+	.splice_read = adb_splice_read,
+	.splice_write = adb_splice_write,
 	.open = adb_open,
 	.release = adb_release,
 };
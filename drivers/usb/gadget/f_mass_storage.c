@@ -284,6 +284,7 @@
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/limits.h>
+#include <linux/mm.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -310,6 +311,9 @@ static const char fsg_string_interface[] = "Mass Storage";
 #define FSG_NO_OTG               1
 #define FSG_NO_INTR_EP           1
 
+#define FSG_NUM_BUFFERS	CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
+#define FSG_BUFLEN	((u32)CONFIG_USB_GADGET_STORAGE_BUFLEN)
+
 #include "storage_common.c"
 
 
@@ -738,6 +742,55 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * If this READ continues the previous one the host is most likely
+ * streaming, so start reading the range it will ask for next.  The
+ * window doubles with each sequential READ up to FSG_READAHEAD_MAX.
+ */
+static void fsg_lun_readahead(struct fsg_lun *curlun, loff_t file_offset,
+			      u32 amount)
+{
+	struct file	*filp = curlun->filp;
+	loff_t		end = file_offset + amount;
+	unsigned long	nr_pages;
+
+	if (file_offset != curlun->ra_next) {
+		curlun->ra_next = end;
+		curlun->ra_window = 0;
+		return;
+	}
+	curlun->ra_next = end;
+	curlun->ra_window = min(max(curlun->ra_window * 2, amount),
+				FSG_READAHEAD_MAX);
+
+	if (end >= curlun->file_length)
+		return;
+	nr_pages = (min((loff_t)curlun->ra_window, curlun->file_length - end)
+		    + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	page_cache_sync_readahead(filp->f_mapping, &curlun->ra, filp,
+				  end >> PAGE_CACHE_SHIFT, nr_pages);
+}
+
+/*
+ * Writes are left in the page cache; once a sequential stream of them
+ * has built up, start writing it back without waiting so that neither
+ * dirty throttling nor the final SYNCHRONIZE CACHE stalls on it.
+ */
+static void fsg_lun_writebehind(struct fsg_lun *curlun, loff_t file_offset,
+				u32 amount)
+{
+	if (file_offset != curlun->wb_end)
+		curlun->wb_start = file_offset;
+	curlun->wb_end = file_offset + amount;
+
+	if (curlun->wb_end - curlun->wb_start >= FSG_WRITEBACK_CHUNK) {
+		__filemap_fdatawrite_range(curlun->filp->f_mapping,
+					   curlun->wb_start, curlun->wb_end - 1,
+					   WB_SYNC_NONE);
+		curlun->wb_start = curlun->wb_end;
+	}
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -785,6 +838,8 @@ static int do_read(struct fsg_common *common)
 	if (curlun->cdrom)
 		amount_left <<= 2;
 
+	fsg_lun_readahead(curlun, file_offset, amount_left);
+
 	for (;;) {
 		/*
 		 * Figure out how much we need to read:
@@ -1045,6 +1100,9 @@ static int do_write(struct fsg_common *common)
 				nwritten -= (nwritten & 511);
 				/* Round down to a block */
 			}
+			if (nwritten > 0)
+				fsg_lun_writebehind(curlun, file_offset,
+						    nwritten);
 			file_offset += nwritten;
 			amount_left_to_write -= nwritten;
 			common->residue -= nwritten;
@@ -1490,6 +1548,8 @@ static int do_start_stop(struct fsg_common *common)
 
 	up_read(&common->filesem);
 	down_write(&common->filesem);
+	/* Writes were left to the page cache, flush them on eject */
+	fsg_lun_fsync_sub(curlun);
 	fsg_lun_close(curlun);
 	up_write(&common->filesem);
 	down_read(&common->filesem);
@@ -2688,6 +2748,7 @@ static int fsg_main_thread(void *common_)
 			if (!fsg_lun_is_open(curlun))
 				continue;
 
+			fsg_lun_fsync_sub(curlun);
 			fsg_lun_close(curlun);
 			curlun->unit_attention_data = SS_MEDIUM_NOT_PRESENT;
 		}
@@ -2701,10 +2762,26 @@ static int fsg_main_thread(void *common_)
 
 /*************************** DEVICE ATTRIBUTES ***************************/
 
+/* Like fsg_store_file(), but flushes the write-behind of the old medium */
+static ssize_t fsg_store_file_sync(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct fsg_lun		*curlun = fsg_lun_from_dev(dev);
+	struct rw_semaphore	*filesem = dev_get_drvdata(dev);
+
+	down_read(filesem);
+	if (fsg_lun_is_open(curlun))
+		fsg_lun_fsync_sub(curlun);
+	up_read(filesem);
+
+	return fsg_store_file(dev, attr, buf, count);
+}
+
 /* Write permission is checked per LUN in store_*() functions. */
 static DEVICE_ATTR(ro, 0644, fsg_show_ro, fsg_store_ro);
 static DEVICE_ATTR(nofua, 0644, fsg_show_nofua, fsg_store_nofua);
-static DEVICE_ATTR(file, 0644, fsg_show_file, fsg_store_file);
+static DEVICE_ATTR(file, 0644, fsg_show_file, fsg_store_file_sync);
 static DEVICE_ATTR(cdrom, 0644, fsg_show_cdrom, fsg_store_cdrom);
 
 
@@ -50,6 +50,9 @@
  * When FSG_BUFFHD_STATIC_BUFFER is defined when this file is included
  * the fsg_buffhd structure's buf field will be an array of FSG_BUFLEN
  * characters rather then a pointer to void.
+ *
+ * FSG_NUM_BUFFERS and FSG_BUFLEN may be defined prior to including this
+ * file to override the number and size of the buffers.
  */
 
 
@@ -247,6 +250,15 @@ struct fsg_lun {
 	u32		sense_data_info;
 	u32		unit_attention_data;
 
+	/* Sequential READ detection, for readahead */
+	loff_t		ra_next;
+	u32		ra_window;
+	struct file_ra_state ra;
+
+	/* Range of a sequential stream of WRITEs not yet written back */
+	loff_t		wb_start;
+	loff_t		wb_end;
+
 	struct device	dev;
 };
 
@@ -263,10 +275,20 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
 /* Number of buffers we will use.  2 is enough for double-buffering */
+#ifndef FSG_NUM_BUFFERS
 #define FSG_NUM_BUFFERS	2
+#endif
 
 /* Default size of buffer length. */
+#ifndef FSG_BUFLEN
 #define FSG_BUFLEN	((u32)16384)
+#endif
+
+/* Largest window read ahead of a sequential stream of READs */
+#define FSG_READAHEAD_MAX	((u32)1024 * 1024)
+
+/* Start writeback of a sequential stream of WRITEs every this many bytes */
+#define FSG_WRITEBACK_CHUNK	((u32)1024 * 1024)
 
 /* Maximal number of LUNs supported in mass storage function */
 #define FSG_MAX_LUNS	8
@@ -603,6 +625,11 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 	curlun->filp = filp;
 	curlun->file_length = size;
 	curlun->num_sectors = num_sectors;
+	curlun->ra_next = -1;
+	curlun->ra_window = 0;
+	file_ra_state_init(&curlun->ra, filp->f_mapping);
+	curlun->ra.ra_pages = FSG_READAHEAD_MAX >> PAGE_CACHE_SHIFT;
+	curlun->wb_start = curlun->wb_end = 0;
 	LDBG(curlun, "open backing file: %s\n", filename);
 	rc = 0;
 
@@ -11,16 +11,29 @@
 #include <linux/fs.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
+#include <linux/rbtree.h>
+#include <linux/module.h>
 #include "fat.h"
 
-/* this must be > 0. */
-#define FAT_MAX_CACHE	8
+/*
+ * Each inode keeps the contiguous runs of its cluster chain that have been
+ * walked in an rbtree indexed by file cluster, so a walked chain is fully
+ * described and lookups are O(log runs).  The runs of all inodes share a
+ * global LRU, approximated by a referenced bit, that is shrunk when more
+ * than fat_cache_max runs are cached and under memory pressure.
+ */
+static unsigned int fat_cache_max = 16384;
+module_param_named(max_cache_extents, fat_cache_max, uint, 0644);
+MODULE_PARM_DESC(max_cache_extents, "Max cached cluster runs of all inodes");
 
 struct fat_cache {
-	struct list_head cache_list;
+	struct rb_node rb_node;
+	struct list_head lru;		/* on fat_cache_lru */
+	struct msdos_inode_info *owner;
 	int nr_contig;	/* number of contiguous clusters */
 	int fcluster;	/* cluster number in the file. */
 	int dcluster;	/* cluster number on disk. */
+	int referenced;
 };
 
 struct fat_cache_id {
@@ -30,10 +43,10 @@ struct fat_cache_id {
 	int dcluster;
 };
 
-static inline int fat_max_cache(struct inode *inode)
-{
-	return FAT_MAX_CACHE;
-}
+/* Lock order: msdos_inode_info->cache_lock, then fat_cache_lru_lock */
+static DEFINE_SPINLOCK(fat_cache_lru_lock);
+static LIST_HEAD(fat_cache_lru);
+static unsigned int fat_cache_nr;
 
 static struct kmem_cache *fat_cache_cachep;
 
@@ -41,9 +54,16 @@ static void init_once(void *foo)
 {
 	struct fat_cache *cache = (struct fat_cache *)foo;
 
-	INIT_LIST_HEAD(&cache->cache_list);
+	INIT_LIST_HEAD(&cache->lru);
 }
 
+static int fat_cache_shrink(struct shrinker *shrink, struct shrink_control *sc);
+
+static struct shrinker fat_cache_shrinker = {
+	.shrink = fat_cache_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
 int __init fat_cache_init(void)
 {
 	fat_cache_cachep = kmem_cache_create("fat_cache",
@@ -52,11 +72,13 @@ int __init fat_cache_init(void)
 				init_once);
 	if (fat_cache_cachep == NULL)
 		return -ENOMEM;
+	register_shrinker(&fat_cache_shrinker);
 	return 0;
 }
 
 void fat_cache_destroy(void)
 {
+	unregister_shrinker(&fat_cache_shrinker);
 	kmem_cache_destroy(fat_cache_cachep);
 }
 
@@ -67,134 +89,180 @@ static inline struct fat_cache *fat_cache_alloc(struct inode *inode)
 
 static inline void fat_cache_free(struct fat_cache *cache)
 {
-	BUG_ON(!list_empty(&cache->cache_list));
+	BUG_ON(!list_empty(&cache->lru));
 	kmem_cache_free(fat_cache_cachep, cache);
 }
 
-static inline void fat_cache_update_lru(struct inode *inode,
-					struct fat_cache *cache)
+/* Must hold both cache_lock of the owner and fat_cache_lru_lock */
+static void fat_cache_unlink(struct fat_cache *cache)
 {
-	if (MSDOS_I(inode)->cache_lru.next != &cache->cache_list)
-		list_move(&cache->cache_list, &MSDOS_I(inode)->cache_lru);
+	rb_erase(&cache->rb_node, &cache->owner->cache_tree);
+	cache->owner->nr_caches--;
+	list_del_init(&cache->lru);
+	fat_cache_nr--;
+}
+
+/*
+ * Drop up to @nr_to_scan runs from the cold end of the LRU.  Referenced
+ * runs and runs of inodes whose lock is busy get another round.
+ */
+static void fat_cache_evict(unsigned long nr_to_scan)
+{
+	struct msdos_inode_info *ei;
+	struct fat_cache *cache;
+
+	spin_lock(&fat_cache_lru_lock);
+	while (nr_to_scan-- && !list_empty(&fat_cache_lru)) {
+		cache = list_entry(fat_cache_lru.prev, struct fat_cache, lru);
+		ei = cache->owner;
+		if (cache->referenced || !spin_trylock(&ei->cache_lock)) {
+			cache->referenced = 0;
+			list_move(&cache->lru, &fat_cache_lru);
+			continue;
+		}
+		fat_cache_unlink(cache);
+		spin_unlock(&ei->cache_lock);
+		fat_cache_free(cache);
+	}
+	spin_unlock(&fat_cache_lru_lock);
+}
+
+static int fat_cache_shrink(struct shrinker *shrink, struct shrink_control *sc)
+{
+	if (sc->nr_to_scan)
+		fat_cache_evict(sc->nr_to_scan);
+	return (fat_cache_nr / 100) * sysctl_vfs_cache_pressure;
 }
 
 static int fat_cache_lookup(struct inode *inode, int fclus,
 			    struct fat_cache_id *cid,
 			    int *cached_fclus, int *cached_dclus)
 {
-	static struct fat_cache nohit = { .fcluster = 0, };
-
-	struct fat_cache *hit = &nohit, *p;
+	struct msdos_inode_info *ei = MSDOS_I(inode);
+	struct fat_cache *hit = NULL, *p;
+	struct rb_node *n;
 	int offset = -1;
 
-	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the cache of "fclus" or nearest cache. */
-		if (p->fcluster <= fclus && hit->fcluster < p->fcluster) {
+	spin_lock(&ei->cache_lock);
+	/* Find the cache of "fclus" or the nearest one before it. */
+	n = ei->cache_tree.rb_node;
+	while (n) {
+		p = rb_entry(n, struct fat_cache, rb_node);
+		if (p->fcluster <= fclus) {
 			hit = p;
-			if ((hit->fcluster + hit->nr_contig) < fclus) {
-				offset = hit->nr_contig;
-			} else {
-				offset = fclus - hit->fcluster;
-				break;
-			}
+			n = n->rb_right;
+		} else {
+			n = n->rb_left;
 		}
 	}
-	if (hit != &nohit) {
-		fat_cache_update_lru(inode, hit);
+	if (hit) {
+		hit->referenced = 1;
+		offset = min(fclus - hit->fcluster, hit->nr_contig);
 
-		cid->id = MSDOS_I(inode)->cache_valid_id;
+		cid->id = ei->cache_valid_id;
 		cid->nr_contig = hit->nr_contig;
 		cid->fcluster = hit->fcluster;
 		cid->dcluster = hit->dcluster;
 		*cached_fclus = cid->fcluster + offset;
 		*cached_dclus = cid->dcluster + offset;
 	}
-	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
+	spin_unlock(&ei->cache_lock);
 
 	return offset;
 }
 
-static struct fat_cache *fat_cache_merge(struct inode *inode,
-					 struct fat_cache_id *new)
+/*
+ * Extend the run already cached at the file cluster of "new", or else
+ * insert @tmp for it.  Returns 0 if merged, 1 if @tmp was inserted and
+ * -ENOMEM if @tmp is needed but NULL.
+ */
+static int fat_cache_insert(struct msdos_inode_info *ei,
+			     struct fat_cache_id *new, struct fat_cache *tmp)
 {
+	struct rb_node **link = &ei->cache_tree.rb_node, *parent = NULL;
 	struct fat_cache *p;
 
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the same part as "new" in cluster-chain. */
-		if (p->fcluster == new->fcluster) {
+	while (*link) {
+		parent = *link;
+		p = rb_entry(parent, struct fat_cache, rb_node);
+		if (new->fcluster < p->fcluster) {
+			link = &parent->rb_left;
+		} else if (new->fcluster > p->fcluster) {
+			link = &parent->rb_right;
+		} else {
+			/* Find the same part as "new" in cluster-chain. */
 			BUG_ON(p->dcluster != new->dcluster);
 			if (new->nr_contig > p->nr_contig)
 				p->nr_contig = new->nr_contig;
-			return p;
+			p->referenced = 1;
+			return 0;
 		}
 	}
-	return NULL;
+	if (!tmp)
+		return -ENOMEM;
+
+	tmp->owner = ei;
+	tmp->fcluster = new->fcluster;
+	tmp->dcluster = new->dcluster;
+	tmp->nr_contig = new->nr_contig;
+	tmp->referenced = 0;
+	rb_link_node(&tmp->rb_node, parent, link);
+	rb_insert_color(&tmp->rb_node, &ei->cache_tree);
+	ei->nr_caches++;
+
+	spin_lock(&fat_cache_lru_lock);
+	list_add(&tmp->lru, &fat_cache_lru);
+	fat_cache_nr++;
+	spin_unlock(&fat_cache_lru_lock);
+	return 1;
 }
 
 static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
 {
-	struct fat_cache *cache, *tmp;
+	struct msdos_inode_info *ei = MSDOS_I(inode);
+	struct fat_cache *tmp;
+	unsigned int nr;
 
-	if (new->fcluster == -1) /* dummy cache */
-		return;
-
-	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-	if (new->id != FAT_CACHE_VALID &&
-	    new->id != MSDOS_I(inode)->cache_valid_id)
+	spin_lock(&ei->cache_lock);
+	if (new->id != FAT_CACHE_VALID && new->id != ei->cache_valid_id)
 		goto out;	/* this cache was invalidated */
+	if (fat_cache_insert(ei, new, NULL) != -ENOMEM)
+		goto out;
+	spin_unlock(&ei->cache_lock);
 
-	cache = fat_cache_merge(inode, new);
-	if (cache == NULL) {
-		if (MSDOS_I(inode)->nr_caches < fat_max_cache(inode)) {
-			MSDOS_I(inode)->nr_caches++;
-			spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
-
-			tmp = fat_cache_alloc(inode);
-			if (!tmp) {
-				spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-				MSDOS_I(inode)->nr_caches--;
-				spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
-				return;
-			}
-
-			spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-			cache = fat_cache_merge(inode, new);
-			if (cache != NULL) {
-				MSDOS_I(inode)->nr_caches--;
-				fat_cache_free(tmp);
-				goto out_update_lru;
-			}
-			cache = tmp;
-		} else {
-			struct list_head *p = MSDOS_I(inode)->cache_lru.prev;
-			cache = list_entry(p, struct fat_cache, cache_list);
-		}
-		cache->fcluster = new->fcluster;
-		cache->dcluster = new->dcluster;
-		cache->nr_contig = new->nr_contig;
+	tmp = fat_cache_alloc(inode);
+	if (!tmp)
+		return;
+
+	spin_lock(&ei->cache_lock);
+	if ((new->id != FAT_CACHE_VALID && new->id != ei->cache_valid_id) ||
+	    fat_cache_insert(ei, new, tmp) != 1) {
+		spin_unlock(&ei->cache_lock);
+		fat_cache_free(tmp);
+		return;
 	}
-out_update_lru:
-	fat_cache_update_lru(inode, cache);
 out:
-	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
+	spin_unlock(&ei->cache_lock);
+
+	nr = ACCESS_ONCE(fat_cache_nr);
+	if (nr > fat_cache_max)
+		fat_cache_evict(nr - fat_cache_max);
 }
 
-/*
- * Cache invalidation occurs rarely, thus the LRU chain is not updated. It
- * fixes itself after a while.
- */
 static void __fat_cache_inval_inode(struct inode *inode)
 {
 	struct msdos_inode_info *i = MSDOS_I(inode);
-	struct fat_cache *cache;
+	struct rb_node *n;
+
+	spin_lock(&fat_cache_lru_lock);
+	while ((n = rb_first(&i->cache_tree)) != NULL) {
+		struct fat_cache *cache = rb_entry(n, struct fat_cache, rb_node);
 
-	while (!list_empty(&i->cache_lru)) {
-		cache = list_entry(i->cache_lru.next, struct fat_cache, cache_list);
-		list_del_init(&cache->cache_list);
-		i->nr_caches--;
+		fat_cache_unlink(cache);
 		fat_cache_free(cache);
 	}
+	spin_unlock(&fat_cache_lru_lock);
+
 	/* Update. The copy of caches before this id is discarded. */
 	i->cache_valid_id++;
 	if (i->cache_valid_id == FAT_CACHE_VALID)
@@ -203,9 +271,9 @@ static void __fat_cache_inval_inode(struct inode *inode)
 
 void fat_cache_inval_inode(struct inode *inode)
 {
-	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
+	spin_lock(&MSDOS_I(inode)->cache_lock);
 	__fat_cache_inval_inode(inode);
-	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
+	spin_unlock(&MSDOS_I(inode)->cache_lock);
 }
 
 static inline int cache_contiguous(struct fat_cache_id *cid, int dclus)
@@ -238,11 +306,8 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		return 0;
 
 	if (fat_cache_lookup(inode, cluster, &cid, fclus, dclus) < 0) {
-		/*
-		 * dummy, always not contiguous
-		 * This is reinitialized by cache_init(), later.
-		 */
-		cache_init(&cid, -1, -1);
+		/* Nothing cached yet, start with the run at the chain head */
+		cache_init(&cid, 0, *dclus);
 	}
 
 	fatent_init(&fatent);
@@ -272,8 +337,12 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 		}
 		(*fclus)++;
 		*dclus = nr;
-		if (!cache_contiguous(&cid, *dclus))
+		if (!cache_contiguous(&cid, *dclus)) {
+			/* The run ended, cache it so the chain is described */
+			cid.nr_contig--;
+			fat_cache_add(inode, &cid);
 			cache_init(&cid, *fclus, *dclus);
+		}
 	}
 	nr = 0;
 	fat_cache_add(inode, &cid);
@@ -7,6 +7,8 @@
 #include <linux/fs.h>
 #include <linux/mutex.h>
 #include <linux/ratelimit.h>
+#include <linux/rbtree.h>
+#include <linux/workqueue.h>
 #include <linux/msdos_fs.h>
 
 /*
@@ -72,6 +74,11 @@ struct msdos_sb_info {
 	unsigned int prev_free;      /* previously allocated cluster number */
 	unsigned int free_clusters;  /* -1 if undefined */
 	unsigned int free_clus_valid; /* is free_clusters valid? */
+	unsigned long *free_bitmap;  /* bit set for each free cluster */
+	unsigned int free_bitmap_scanned; /* free_bitmap is valid below this */
+	unsigned int free_bitmap_ready; /* whole FAT is in free_bitmap */
+	unsigned int free_bitmap_stop; /* umount in progress */
+	struct work_struct free_bitmap_work; /* builds free_bitmap */
 	struct fat_mount_options options;
 	struct nls_table *nls_disk;  /* Codepage used on disk */
 	struct nls_table *nls_io;    /* Charset used for input and display */
@@ -96,8 +103,8 @@ struct msdos_sb_info {
  * MS-DOS file system inode data in memory
  */
 struct msdos_inode_info {
-	spinlock_t cache_lru_lock;
-	struct list_head cache_lru;
+	spinlock_t cache_lock;		/* protects cache_tree */
+	struct rb_root cache_tree;	/* cached runs of the cluster chain */
 	int nr_caches;
 	/* for avoiding the race between fat_free() and fat_get_cluster() */
 	unsigned int cache_valid_id;
@@ -106,6 +113,7 @@ struct msdos_inode_info {
 	loff_t mmu_private;	/* physically allocated size */
 
 	int i_start;		/* first cluster or 0 */
+	int i_alloc_hint;	/* cluster to try first on allocation, or 0 */
 	int i_logstart;		/* logical first cluster */
 	int i_attrs;		/* unused attribute bits */
 	loff_t i_pos;		/* on-disk position of directory entry or 0 */
@@ -300,6 +308,8 @@ extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+extern void fat_free_bitmap_init(struct super_block *sb);
+extern void fat_free_bitmap_release(struct super_block *sb);
 
 /* fat/file.c */
 extern long fat_generic_ioctl(struct file *filp, unsigned int cmd,
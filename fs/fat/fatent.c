@@ -7,6 +7,7 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -452,6 +453,113 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/*
+ * Free cluster bitmap.
+ *
+ * Scanning the FAT for a free entry, or to count the free entries for
+ * statfs(), reads the whole table on large volumes.  Instead, a bitmap
+ * of the free clusters is built by a background scan after mount, and
+ * is kept up to date by the allocator from then on.
+ *
+ * The scan takes ->fat_lock for each FAT block, and bits below
+ * ->free_bitmap_scanned are updated under ->fat_lock on every allocation
+ * or free.  Entries beyond that point will be read by the scan, so
+ * the bitmap is consistent once the scan reaches ->max_cluster.
+ */
+static inline void fat_free_bitmap_mark(struct msdos_sb_info *sbi, int entry,
+					int free)
+{
+	if (entry < sbi->free_bitmap_scanned) {
+		if (free)
+			__set_bit(entry, sbi->free_bitmap);
+		else
+			__clear_bit(entry, sbi->free_bitmap);
+	}
+}
+
+/* Returns the first free cluster at or after @start, wrapping around */
+static int fat_free_bitmap_next(struct msdos_sb_info *sbi, unsigned long start)
+{
+	unsigned long max = sbi->max_cluster;
+	unsigned long entry;
+
+	if (start >= max)
+		start = FAT_START_ENT;
+	entry = find_next_bit(sbi->free_bitmap, max, start);
+	if (entry < max)
+		return entry;
+	entry = find_next_bit(sbi->free_bitmap, start, FAT_START_ENT);
+	if (entry < start)
+		return entry;
+	return -1;
+}
+
+/* Returns the start of a run of @nr free clusters in [@from, @to) */
+static int fat_free_bitmap_run(struct msdos_sb_info *sbi, unsigned long from,
+			       unsigned long to, int nr)
+{
+	unsigned long pos = from, end;
+
+	while ((pos = find_next_bit(sbi->free_bitmap, to, pos)) < to) {
+		end = find_next_zero_bit(sbi->free_bitmap, to, pos);
+		if (end - pos >= nr)
+			return pos;
+		pos = end;
+	}
+	return -1;
+}
+
+static int fat_free_bitmap_first(struct inode *inode, int nr_cluster)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+	unsigned long max = sbi->max_cluster;
+	unsigned long start;
+	int hint = MSDOS_I(inode)->i_alloc_hint;
+	int entry;
+
+	/* Extend the run this inode allocated last, if possible */
+	if (hint >= FAT_START_ENT && hint < max &&
+	    test_bit(hint, sbi->free_bitmap))
+		return hint;
+
+	start = sbi->prev_free + 1;
+	if (start >= max)
+		start = FAT_START_ENT;
+	if (nr_cluster > 1) {
+		/* Prefer a hole which takes the whole request */
+		entry = fat_free_bitmap_run(sbi, start, max, nr_cluster);
+		if (entry < 0)
+			entry = fat_free_bitmap_run(sbi, FAT_START_ENT, start,
+						    nr_cluster);
+		if (entry >= 0)
+			return entry;
+	}
+	return fat_free_bitmap_next(sbi, start);
+}
+
+/* Link the free entry @fatent to the end of the chain being allocated */
+static void fat_alloc_link(struct super_block *sb, struct fat_entry *fatent,
+			   struct fat_entry *prev_ent,
+			   struct buffer_head **bhs, int *nr_bhs)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	int entry = fatent->entry;
+
+	/* make the cluster chain */
+	ops->ent_put(fatent, FAT_ENT_EOF);
+	if (prev_ent->nr_bhs)
+		ops->ent_put(prev_ent, entry);
+
+	fat_collect_bhs(bhs, nr_bhs, fatent);
+
+	sbi->prev_free = entry;
+	if (sbi->free_clusters != -1)
+		sbi->free_clusters--;
+	fat_free_bitmap_mark(sbi, entry, 0);
+	sb->s_dirt = 1;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -471,9 +579,36 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	}
 
 	err = nr_bhs = idx_clus = 0;
-	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
+
+	if (sbi->free_bitmap_ready) {
+		int entry = fat_free_bitmap_first(inode, nr_cluster);
+
+		while (entry >= 0) {
+			err = fat_ent_read(inode, &fatent, entry);
+			if (err < 0)
+				goto out;
+			if (err != FAT_ENT_FREE) {
+				fat_fs_error(sb, "%s: free cluster bitmap out of "
+					     "sync (entry 0x%08x)", __func__, entry);
+				err = -EIO;
+				goto out;
+			}
+			fat_alloc_link(sb, &fatent, &prev_ent, bhs, &nr_bhs);
+
+			cluster[idx_clus] = entry;
+			idx_clus++;
+			if (idx_clus == nr_cluster)
+				goto done;
+
+			prev_ent = fatent;
+			entry = fat_free_bitmap_next(sbi, entry + 1);
+		}
+		goto nospc;
+	}
+
+	count = FAT_START_ENT;
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -486,24 +621,13 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		/* Find the free entries in a block */
 		do {
 			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
-				int entry = fatent.entry;
-
-				/* make the cluster chain */
-				ops->ent_put(&fatent, FAT_ENT_EOF);
-				if (prev_ent.nr_bhs)
-					ops->ent_put(&prev_ent, entry);
-
-				fat_collect_bhs(bhs, &nr_bhs, &fatent);
+				fat_alloc_link(sb, &fatent, &prev_ent,
+					       bhs, &nr_bhs);
 
-				sbi->prev_free = entry;
-				if (sbi->free_clusters != -1)
-					sbi->free_clusters--;
-				sb->s_dirt = 1;
-
-				cluster[idx_clus] = entry;
+				cluster[idx_clus] = fatent.entry;
 				idx_clus++;
 				if (idx_clus == nr_cluster)
-					goto out;
+					goto done;
 
 				/*
 				 * fat_collect_bhs() gets ref-count of bhs,
@@ -517,12 +641,18 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
 	sb->s_dirt = 1;
 	err = -ENOSPC;
+	goto out;
 
+done:
+	/* Try to continue this chain contiguously on the next allocation */
+	MSDOS_I(inode)->i_alloc_hint = cluster[idx_clus - 1] + 1;
+	err = 0;
 out:
 	unlock_fat(sbi);
 	fatent_brelse(&fatent);
@@ -589,6 +719,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
 		}
+		fat_free_bitmap_mark(sbi, fatent.entry, 1);
 
 		if (nr_bhs + fatent.nr_bhs > MAX_BUF_PER_PAGE) {
 			if (sb->s_flags & MS_SYNCHRONOUS) {
@@ -647,6 +778,10 @@ int fat_count_free_clusters(struct super_block *sb)
 	unsigned long reada_blocks, reada_mask, cur_block;
 	int err = 0, free;
 
+	/* The bitmap scan will have the count, don't read the FAT twice */
+	if (sbi->free_bitmap && !sbi->free_bitmap_ready)
+		flush_work(&sbi->free_bitmap_work);
+
 	lock_fat(sbi);
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
@@ -683,3 +818,85 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+static void fat_free_bitmap_build(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi =
+		container_of(work, struct msdos_sb_info, free_bitmap_work);
+	struct super_block *sb = sbi->fat_inode->i_sb;
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, reada_mask, cur_block;
+	int err = 0;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster && !sbi->free_bitmap_stop) {
+		/* readahead of fat blocks */
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		/* Only hold off allocations for one block at a time */
+		lock_fat(sbi);
+		err = fat_ent_read_block(sb, &fatent);
+		if (err) {
+			unlock_fat(sbi);
+			break;
+		}
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE)
+				__set_bit(fatent.entry, sbi->free_bitmap);
+		} while (fat_ent_next(sbi, &fatent));
+		sbi->free_bitmap_scanned = fatent.entry;
+		unlock_fat(sbi);
+
+		cond_resched();
+	}
+	fatent_brelse(&fatent);
+
+	lock_fat(sbi);
+	if (err) {
+		/* Fall back to scanning the FAT */
+		sbi->free_bitmap_scanned = 0;
+	} else if (!sbi->free_bitmap_stop) {
+		sbi->free_clusters = bitmap_weight(sbi->free_bitmap,
+						   sbi->max_cluster);
+		sbi->free_clus_valid = 1;
+		sbi->free_bitmap_ready = 1;
+		sb->s_dirt = 1;
+	}
+	unlock_fat(sbi);
+}
+
+void fat_free_bitmap_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	sbi->free_bitmap = vzalloc(BITS_TO_LONGS(sbi->max_cluster) *
+				   sizeof(unsigned long));
+	if (!sbi->free_bitmap)
+		return;
+
+	INIT_WORK(&sbi->free_bitmap_work, fat_free_bitmap_build);
+	queue_work(system_long_wq, &sbi->free_bitmap_work);
+}
+
+void fat_free_bitmap_release(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	if (!sbi->free_bitmap)
+		return;
+
+	sbi->free_bitmap_stop = 1;
+	cancel_work_sync(&sbi->free_bitmap_work);
+	vfree(sbi->free_bitmap);
+	sbi->free_bitmap = NULL;
+}
@@ -487,6 +487,8 @@ static void fat_put_super(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 
+	fat_free_bitmap_release(sb);
+
 	if (sb->s_dirt)
 		fat_write_super(sb);
 
@@ -510,6 +512,7 @@ static struct inode *fat_alloc_inode(struct super_block *sb)
 	ei = kmem_cache_alloc(fat_inode_cachep, GFP_NOFS);
 	if (!ei)
 		return NULL;
+	ei->i_alloc_hint = 0;
 	return &ei->vfs_inode;
 }
 
@@ -529,10 +532,10 @@ static void init_once(void *foo)
 {
 	struct msdos_inode_info *ei = (struct msdos_inode_info *)foo;
 
-	spin_lock_init(&ei->cache_lru_lock);
+	spin_lock_init(&ei->cache_lock);
 	ei->nr_caches = 0;
 	ei->cache_valid_id = FAT_CACHE_VALID + 1;
-	INIT_LIST_HEAD(&ei->cache_lru);
+	ei->cache_tree = RB_ROOT;
 	INIT_HLIST_NODE(&ei->i_fat_hash);
 	inode_init_once(&ei->vfs_inode);
 }
@@ -1528,6 +1531,8 @@ int fat_fill_super(struct super_block *sb, void *data, int silent, int isvfat,
 		goto out_fail;
 	}
 
+	fat_free_bitmap_init(sb);
+
 	return 0;
 
 out_invalid:
@@ -20,6 +20,7 @@
 #include <linux/swap.h>
 #include <linux/splice.h>
 #include <linux/freezer.h>
+#include <linux/uaccess.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -63,6 +64,8 @@ struct fuse_req *fuse_request_alloc_nofs(void)
 
 void fuse_request_free(struct fuse_req *req)
 {
+	if (req->passthrough_filp)
+		fput(req->passthrough_filp);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
@@ -1727,6 +1730,10 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
 
+	/* The lower file descriptor is looked up in the server's context */
+	if (!err && fc->passthrough)
+		fuse_setup_passthrough(fc, req);
+
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (!err) {
@@ -2001,6 +2008,31 @@ static int fuse_dev_fasync(int fd, struct file *file, int on)
 	return fasync_helper(fd, file, on, &fc->fasync);
 }
 
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	struct fuse_conn *fc = fuse_get_conn(file);
+	u32 val;
+
+	if (!fc)
+		return -EPERM;
+
+	switch (cmd) {
+	case FUSE_DEV_IOC_PASSTHROUGH_OPEN:
+		if (get_user(val, (u32 __user *)arg))
+			return -EFAULT;
+		return fuse_passthrough_open(fc, val);
+
+	case FUSE_DEV_IOC_PASSTHROUGH_CLOSE:
+		if (get_user(val, (u32 __user *)arg))
+			return -EFAULT;
+		return fuse_passthrough_close(fc, val);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
 const struct file_operations fuse_dev_operations = {
 	.owner		= THIS_MODULE,
 	.llseek		= no_llseek,
@@ -2013,6 +2045,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
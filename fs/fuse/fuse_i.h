@@ -22,6 +22,7 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 #include <linux/workqueue.h>
+#include <linux/idr.h>
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -44,6 +45,8 @@
     doing the mount will be allowed to access the filesystem */
 #define FUSE_ALLOW_OTHER         (1 << 1)
 
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** List of active connections */
 extern struct list_head fuse_conn_list;
 
@@ -138,6 +141,9 @@ struct fuse_file {
 
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
+
+	/** Lower file that read, write and mmap are passed to, or NULL */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -310,6 +316,9 @@ struct fuse_req {
 
 	/** Request is stolen from fuse_file->reserved_req */
 	struct file *stolen_file;
+
+	/** Lower file passed in the reply to OPEN or CREATE */
+	struct file *passthrough_filp;
 };
 
 /**
@@ -475,6 +484,12 @@ struct fuse_conn {
 	/** Don't apply umask to creation modes */
 	unsigned dont_mask:1;
 
+	/** Filesystem may pass a lower file for read/write/mmap */
+	unsigned passthrough:1;
+
+	/** Lower files registered for passthrough, protected by lock */
+	struct idr passthrough_idr;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -766,4 +781,22 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/* passthrough.c */
+
+/** Open flags the fuse file and its lower file must agree on */
+#define FUSE_PASSTHROUGH_FLAGS	(O_APPEND | O_DIRECT)
+
+int fuse_passthrough_open(struct fuse_conn *fc, unsigned int fd);
+int fuse_passthrough_close(struct fuse_conn *fc, unsigned int id);
+void fuse_passthrough_free_all(struct fuse_conn *fc);
+void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_attach(struct fuse_file *ff, struct fuse_req *req,
+			     int flags);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+void fuse_passthrough_release(struct fuse_file *ff);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,272 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough of read, write and mmap to a lower file.
+ *
+ * A filesystem which merely stacks on top of another one (such as an
+ * emulated sdcard) registers the already opened lower file with an ioctl
+ * on /dev/fuse, and replies to OPEN and CREATE with FOPEN_PASSTHROUGH and
+ * the id it got back.  From then on read, write and mmap of the fuse file
+ * are served by the lower file directly, while everything else still
+ * goes to the filesystem daemon.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fs_stack.h>
+#include <linux/capability.h>
+#include <linux/fsnotify.h>
+#include <linux/mm.h>
+
+/*
+ * FUSE_DEV_IOC_PASSTHROUGH_OPEN: register a lower file of the server with
+ * the connection.  The returned id is what the server then puts in
+ * fuse_open_out.passthrough_fh.  Only a privileged server may do this, so
+ * a process tricked into writing a reply to /dev/fuse can't hand out its
+ * own files.
+ */
+int fuse_passthrough_open(struct fuse_conn *fc, unsigned int fd)
+{
+	struct file *passthrough_filp;
+	struct inode *passthrough_inode;
+	int id, err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	passthrough_filp = fget(fd);
+	if (!passthrough_filp)
+		return -EBADF;
+
+	/* Don't stack on fuse itself, and only on files we can do I/O on */
+	passthrough_inode = passthrough_filp->f_path.dentry->d_inode;
+	err = -EINVAL;
+	if (!S_ISREG(passthrough_inode->i_mode) ||
+	    passthrough_inode->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !passthrough_filp->f_op || !passthrough_filp->f_op->aio_read ||
+	    !passthrough_filp->f_op->aio_write)
+		goto out_fput;
+
+	do {
+		err = -ENOMEM;
+		if (!idr_pre_get(&fc->passthrough_idr, GFP_KERNEL))
+			goto out_fput;
+
+		spin_lock(&fc->lock);
+		err = idr_get_new(&fc->passthrough_idr, passthrough_filp, &id);
+		spin_unlock(&fc->lock);
+	} while (err == -EAGAIN);
+
+	if (err)
+		goto out_fput;
+
+	return id;
+
+ out_fput:
+	fput(passthrough_filp);
+	return err;
+}
+
+/*
+ * FUSE_DEV_IOC_PASSTHROUGH_CLOSE: drop the registration.  Files already
+ * opened with this id keep their own reference.
+ */
+int fuse_passthrough_close(struct fuse_conn *fc, unsigned int id)
+{
+	struct file *passthrough_filp;
+
+	spin_lock(&fc->lock);
+	passthrough_filp = idr_find(&fc->passthrough_idr, id);
+	if (passthrough_filp)
+		idr_remove(&fc->passthrough_idr, id);
+	spin_unlock(&fc->lock);
+
+	if (!passthrough_filp)
+		return -ENOENT;
+
+	fput(passthrough_filp);
+	return 0;
+}
+
+static int fuse_passthrough_put_one(int id, void *p, void *data)
+{
+	fput(p);
+	return 0;
+}
+
+/* Called when the last reference to the connection is dropped */
+void fuse_passthrough_free_all(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->passthrough_idr, fuse_passthrough_put_one, NULL);
+	idr_remove_all(&fc->passthrough_idr);
+	idr_destroy(&fc->passthrough_idr);
+}
+
+/*
+ * Called with the reply to OPEN or CREATE copied in.  Takes a reference
+ * to the registered lower file for the request, fuse_passthrough_attach()
+ * then moves it to the fuse_file.
+ */
+void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *passthrough_filp;
+
+	if (req->out.h.error)
+		return;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	spin_lock(&fc->lock);
+	passthrough_filp = idr_find(&fc->passthrough_idr, outarg->passthrough_fh);
+	if (passthrough_filp)
+		get_file(passthrough_filp);
+	spin_unlock(&fc->lock);
+
+	if (!passthrough_filp) {
+		printk(KERN_WARNING "fuse: passthrough id %u is not registered\n",
+		       outarg->passthrough_fh);
+		return;
+	}
+
+	req->passthrough_filp = passthrough_filp;
+}
+
+/*
+ * The lower filesystem checks its own file's flags, so only pass through
+ * if they agree with the flags the fuse file is opened with.
+ */
+void fuse_passthrough_attach(struct fuse_file *ff, struct fuse_req *req,
+			     int flags)
+{
+	struct file *passthrough_filp = req->passthrough_filp;
+
+	if (!passthrough_filp)
+		return;
+
+	req->passthrough_filp = NULL;
+	if ((flags ^ passthrough_filp->f_flags) & FUSE_PASSTHROUGH_FLAGS) {
+		printk(KERN_WARNING "fuse: passthrough file opened with "
+		       "different O_APPEND or O_DIRECT\n");
+		fput(passthrough_filp);
+		return;
+	}
+
+	ff->passthrough_filp = passthrough_filp;
+}
+
+static ssize_t fuse_passthrough_aio_rw(struct kiocb *iocb,
+				       const struct iovec *iov,
+				       unsigned long nr_segs, loff_t pos,
+				       int write)
+{
+	struct file *fuse_filp = iocb->ki_filp;
+	struct fuse_file *ff = fuse_filp->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+	struct inode *fuse_inode = fuse_filp->f_path.dentry->d_inode;
+	struct inode *passthrough_inode;
+	ssize_t ret;
+
+	if (!(passthrough_filp->f_mode & (write ? FMODE_WRITE : FMODE_READ)))
+		return -EBADF;
+
+	/* fcntl(F_SETFL) on the fuse file doesn't reach the lower one */
+	if ((fuse_filp->f_flags ^ passthrough_filp->f_flags) &
+	    FUSE_PASSTHROUGH_FLAGS)
+		return -EINVAL;
+
+	passthrough_inode = passthrough_filp->f_path.dentry->d_inode;
+
+	/* The lower filesystem expects to find its own file in the iocb */
+	iocb->ki_filp = passthrough_filp;
+	if (write)
+		ret = passthrough_filp->f_op->aio_write(iocb, iov, nr_segs, pos);
+	else
+		ret = passthrough_filp->f_op->aio_read(iocb, iov, nr_segs, pos);
+	iocb->ki_filp = fuse_filp;
+
+	if (ret <= 0 && ret != -EIOCBQUEUED)
+		return ret;
+
+	if (write) {
+		fsstack_copy_inode_size(fuse_inode, passthrough_inode);
+		fuse_invalidate_attr(fuse_inode);
+		fsnotify_modify(passthrough_filp);
+	} else {
+		fsnotify_access(passthrough_filp);
+	}
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_aio_rw(iocb, iov, nr_segs, pos, 0);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_aio_rw(iocb, iov, nr_segs, pos, 1);
+}
+
+/*
+ * Map the lower file instead, the vma then refers to it and faults are
+ * served from the lower page cache.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+	int err;
+
+	if (!passthrough_filp->f_op->mmap)
+		return -ENODEV;
+
+	/*
+	 * Same as do_mmap_pgoff() does for the lower file: no writable
+	 * shared mapping unless it was opened for writing.
+	 */
+	if ((vma->vm_flags & VM_SHARED) &&
+	    !(passthrough_filp->f_mode & FMODE_WRITE)) {
+		if (vma->vm_flags & VM_WRITE)
+			return -EACCES;
+		vma->vm_flags &= ~VM_MAYWRITE;
+	}
+
+	vma->vm_file = passthrough_filp;
+	get_file(passthrough_filp);
+	err = passthrough_filp->f_op->mmap(passthrough_filp, vma);
+	if (err) {
+		/* mmap_region() drops the reference to the fuse file */
+		vma->vm_file = file;
+		fput(passthrough_filp);
+		return err;
+	}
+	fput(file);
+
+	return 0;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
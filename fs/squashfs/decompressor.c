@@ -23,6 +23,8 @@
 
 #include <linux/types.h>
 #include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/wait.h>
 #include <linux/slab.h>
 #include <linux/buffer_head.h>
 
@@ -77,34 +79,179 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 }
 
 
-void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
+/*
+ * Each mounted filesystem has a pool of decompressor streams.  A reader
+ * takes a stream from the pool for the duration of one block, so with
+ * more than one stream independent blocks are decompressed in parallel.
+ * Streams beyond the first are allocated on demand, up to max_streams,
+ * after which readers wait for a stream to be returned to the pool.
+ */
+struct squashfs_stream {
+	void			*comp_opts;
+	int			comp_opts_len;
+	struct mutex		mutex;
+	struct list_head	strm_list;
+	int			nr_streams;
+	int			max_streams;
+	wait_queue_head_t	wait;
+};
+
+struct decomp_stream {
+	void			*stream;
+	struct list_head	list;
+};
+
+
+static int squashfs_add_decomp_stream(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *stream)
+{
+	struct decomp_stream *decomp_strm;
+
+	decomp_strm = kmalloc(sizeof(*decomp_strm), GFP_KERNEL);
+	if (decomp_strm == NULL)
+		return -ENOMEM;
+
+	decomp_strm->stream = msblk->decompressor->init(msblk,
+		stream->comp_opts, stream->comp_opts_len);
+	if (IS_ERR(decomp_strm->stream)) {
+		int err = PTR_ERR(decomp_strm->stream);
+
+		kfree(decomp_strm);
+		return err;
+	}
+
+	list_add(&decomp_strm->list, &stream->strm_list);
+	stream->nr_streams++;
+	return 0;
+}
+
+
+static struct decomp_stream *get_decomp_stream(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *stream)
+{
+	struct decomp_stream *decomp_strm;
+
+	while (1) {
+		mutex_lock(&stream->mutex);
+
+		/*
+		 * If allocation of a further stream fails, wait for one of
+		 * the existing streams instead, there is always at least one
+		 */
+		if (list_empty(&stream->strm_list) &&
+				stream->nr_streams < stream->max_streams)
+			squashfs_add_decomp_stream(msblk, stream);
+
+		if (!list_empty(&stream->strm_list)) {
+			decomp_strm = list_first_entry(&stream->strm_list,
+				struct decomp_stream, list);
+			list_del(&decomp_strm->list);
+			mutex_unlock(&stream->mutex);
+			return decomp_strm;
+		}
+
+		mutex_unlock(&stream->mutex);
+		wait_event(stream->wait, !list_empty(&stream->strm_list));
+	}
+}
+
+
+static void put_decomp_stream(struct decomp_stream *decomp_strm,
+	struct squashfs_stream *stream)
+{
+	mutex_lock(&stream->mutex);
+	list_add(&decomp_strm->list, &stream->strm_list);
+	mutex_unlock(&stream->mutex);
+	wake_up(&stream->wait);
+}
+
+
+void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags,
+	int max_streams)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
-	void *strm, *buffer = NULL;
-	int length = 0;
+	struct squashfs_stream *stream;
+	void *buffer = NULL;
+	int length = 0, err;
+
+	stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+	if (stream == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	mutex_init(&stream->mutex);
+	INIT_LIST_HEAD(&stream->strm_list);
+	init_waitqueue_head(&stream->wait);
+	stream->max_streams = max_streams;
 
 	/*
-	 * Read decompressor specific options from file system if present
+	 * Read decompressor specific options from file system if present.
+	 * They are kept to initialise any further streams.
 	 */
 	if (SQUASHFS_COMP_OPTS(flags)) {
 		buffer = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
-		if (buffer == NULL)
-			return ERR_PTR(-ENOMEM);
+		if (buffer == NULL) {
+			err = -ENOMEM;
+			goto failed;
+		}
 
 		length = squashfs_read_data(sb, &buffer,
 			sizeof(struct squashfs_super_block), 0, NULL,
 			PAGE_CACHE_SIZE, 1);
 
 		if (length < 0) {
-			strm = ERR_PTR(length);
-			goto finished;
+			err = length;
+			goto failed;
 		}
 	}
 
-	strm = msblk->decompressor->init(msblk, buffer, length);
+	stream->comp_opts = buffer;
+	stream->comp_opts_len = length;
 
-finished:
+	err = squashfs_add_decomp_stream(msblk, stream);
+	if (err)
+		goto failed;
+
+	return stream;
+
+failed:
 	kfree(buffer);
+	kfree(stream);
+	return ERR_PTR(err);
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk, void *strm)
+{
+	struct squashfs_stream *stream = strm;
+	struct decomp_stream *decomp_strm;
+
+	if (stream == NULL)
+		return;
+
+	while (!list_empty(&stream->strm_list)) {
+		decomp_strm = list_first_entry(&stream->strm_list,
+			struct decomp_stream, list);
+		list_del(&decomp_strm->list);
+		msblk->decompressor->free(decomp_strm->stream);
+		kfree(decomp_strm);
+	}
+
+	kfree(stream->comp_opts);
+	kfree(stream);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	struct squashfs_stream *stream = msblk->stream;
+	struct decomp_stream *decomp_strm = get_decomp_stream(msblk, stream);
+	int res;
+
+	res = msblk->decompressor->decompress(msblk, decomp_strm->stream,
+		buffer, bh, b, offset, length, srclength, pages);
+	put_decomp_stream(decomp_strm, stream);
 
-	return strm;
+	return res;
 }
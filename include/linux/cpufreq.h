@@ -21,6 +21,7 @@
 #include <linux/workqueue.h>
 #include <linux/cpumask.h>
 #include <asm/div64.h>
+#include <asm/cputime.h>
 
 #define CPUFREQ_NAME_LEN 16
 
@@ -405,5 +406,19 @@ void cpufreq_frequency_table_get_attr(struct cpufreq_frequency_table *table,
 
 void cpufreq_frequency_table_put_attr(unsigned int cpu);
 
+/*********************************************************************
+ *                         CPUFREQ STATS                             *
+ *********************************************************************/
+
+struct task_struct;
+
+#ifdef CONFIG_CPU_FREQ_STAT_UID
+void cpufreq_stats_account_uid(struct task_struct *p, cputime_t cputime);
+#else
+static inline void cpufreq_stats_account_uid(struct task_struct *p,
+					     cputime_t cputime)
+{
+}
+#endif
 
 #endif /* _LINUX_CPUFREQ_H */
@@ -198,6 +198,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info; /* last swap fault, see swap_state.c */
+#endif
 #ifdef CONFIG_ZRAM_FOR_ANDROID
 	int vma_swap_done;
 #endif /* CONFIG_ZRAM_FOR_ANDROID */
@@ -348,6 +348,9 @@ struct zone {
 	 */
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
+	/* Where kcompactd stopped scanning, 0 to start over */
+	unsigned long		compact_cached_migrate_pfn;
+	unsigned long		compact_cached_free_pfn;
 #endif
 
 	ZONE_PADDING(_pad1_)
@@ -650,6 +653,11 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;	/* Protected by lock_memory_hotplug() */
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	int kcompactd_max_order;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
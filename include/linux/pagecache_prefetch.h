@@ -0,0 +1,25 @@
+#ifndef _LINUX_PAGECACHE_PREFETCH_H
+#define _LINUX_PAGECACHE_PREFETCH_H
+
+#include <linux/fs.h>
+
+#ifdef CONFIG_PAGECACHE_PREFETCH
+extern int prefetch_recording;
+extern void __prefetch_record(struct file *filp, pgoff_t index);
+
+/*
+ * Called when a page cache page has to be read in from the backing
+ * store, records it in the trace while a recording window is open.
+ */
+static inline void prefetch_record(struct file *filp, pgoff_t index)
+{
+	if (unlikely(prefetch_recording) && filp)
+		__prefetch_record(filp, index);
+}
+#else
+static inline void prefetch_record(struct file *filp, pgoff_t index)
+{
+}
+#endif
+
+#endif /* _LINUX_PAGECACHE_PREFETCH_H */
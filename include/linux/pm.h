@@ -421,6 +421,31 @@ enum rpm_request {
 
 struct wakeup_source;
 
+#ifdef CONFIG_PM_SLEEP
+/*
+ * Per-device system suspend/resume callback latency, kept by the PM core
+ * for every phase.
+ */
+enum dpm_latency_phase {
+	DPM_LATENCY_SUSPEND,
+	DPM_LATENCY_SUSPEND_NOIRQ,
+	DPM_LATENCY_RESUME_NOIRQ,
+	DPM_LATENCY_RESUME,
+	DPM_LATENCY_PHASES
+};
+
+/* <10us, <100us, <1ms, <10ms, <100ms, <1s, >=1s */
+#define DPM_LATENCY_BUCKETS	7
+
+struct dpm_latency {
+	unsigned int		count;
+	unsigned int		hist[DPM_LATENCY_BUCKETS];
+	u64			min_ns;
+	u64			max_ns;
+	u64			total_ns;
+};
+#endif
+
 struct dev_pm_info {
 	pm_message_t		power_state;
 	unsigned int		can_wakeup:1;
@@ -432,6 +457,7 @@ struct dev_pm_info {
 	struct list_head	entry;
 	struct completion	completion;
 	struct wakeup_source	*wakeup;
+	struct dpm_latency	latency[DPM_LATENCY_PHASES];
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -18,6 +18,9 @@
 
 #include <linux/list.h>
 #include <linux/ktime.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
+#include <linux/timerqueue.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
  * states when active. If the type is set to WAKE_LOCK_SUSPEND, the wake_lock
@@ -35,11 +38,14 @@ enum {
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
 	struct list_head    link;
+	struct timerqueue_node timer_node;
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
 #ifdef CONFIG_WAKELOCK_STAT
 	struct {
+		spinlock_t      lock;
+		seqcount_t      seq;
 		int             count;
 		int             expire_count;
 		int             wakeup_count;
@@ -47,6 +53,7 @@ struct wake_lock {
 		ktime_t         prevent_suspend_time;
 		ktime_t         max_time;
 		ktime_t         last_time;
+		ktime_t         sleep_wait_start;
 	} stat;
 #endif
 #endif
@@ -82,6 +82,35 @@ DEFINE_EVENT(loadeval, cpufreq_interactive_notyet,
 	    TP_ARGS(cpu_id, load, curtarg, curactual, newtarg)
 );
 
+TRACE_EVENT(cpufreq_interactive_predict,
+	    TP_PROTO(unsigned long cpu_id, unsigned long load,
+		     unsigned long shortavg, unsigned long longavg,
+		     unsigned long histavg, unsigned long pred),
+	    TP_ARGS(cpu_id, load, shortavg, longavg, histavg, pred),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned long, cpu_id   )
+		    __field(unsigned long, load     )
+		    __field(unsigned long, shortavg )
+		    __field(unsigned long, longavg  )
+		    __field(unsigned long, histavg  )
+		    __field(unsigned long, pred     )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu_id = cpu_id;
+		    __entry->load = load;
+		    __entry->shortavg = shortavg;
+		    __entry->longavg = longavg;
+		    __entry->histavg = histavg;
+		    __entry->pred = pred;
+	    ),
+
+	    TP_printk("cpu=%lu load=%lu short=%lu long=%lu hist=%lu pred=%lu",
+		      __entry->cpu_id, __entry->load, __entry->shortavg,
+		      __entry->longavg, __entry->histavg, __entry->pred)
+);
+
 TRACE_EVENT(cpufreq_interactive_boost,
 	    TP_PROTO(const char *s),
 	    TP_ARGS(s),
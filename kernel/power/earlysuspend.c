@@ -13,10 +13,14 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -38,8 +42,16 @@ atomic_t optimize_comp_on = ATOMIC_INIT(0);
 EXPORT_SYMBOL(optimize_comp_on);
 #endif /* CONFIG_ZRAM_FOR_ANDROID */
 
+/*
+ * If set, the handlers of one level are called concurrently; levels are
+ * still called one after the other.
+ */
+static bool async_handlers;
+module_param(async_handlers, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
+static LIST_HEAD(early_suspend_domain);
 static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
@@ -78,11 +90,38 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void early_suspend_call(struct early_suspend *handler)
+{
+	ktime_t calltime = ktime_get();
+
+	handler->suspend(handler);
+	handler->suspend_time = ktime_sub(ktime_get(), calltime);
+}
+
+static void late_resume_call(struct early_suspend *handler)
+{
+	ktime_t calltime = ktime_get();
+
+	handler->resume(handler);
+	handler->resume_time = ktime_sub(ktime_get(), calltime);
+}
+
+static void async_early_suspend(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data);
+}
+
+static void async_late_resume(void *data, async_cookie_t cookie)
+{
+	late_resume_call(data);
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -106,11 +145,21 @@ static void early_suspend(struct work_struct *work)
 		pr_info("early_suspend: call handlers\n");
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
 		if (pos->suspend != NULL) {
+			if (pos->level != level) {
+				async_synchronize_full_domain(
+					&early_suspend_domain);
+				level = pos->level;
+			}
 			if (debug_mask & DEBUG_VERBOSE)
 				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
+			if (async_handlers)
+				async_schedule_domain(async_early_suspend, pos,
+						      &early_suspend_domain);
+			else
+				early_suspend_call(pos);
 		}
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -129,6 +178,7 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MAX;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -150,12 +200,22 @@ static void late_resume(struct work_struct *work)
 		pr_info("late_resume: call handlers\n");
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
 		if (pos->resume != NULL) {
+			if (pos->level != level) {
+				async_synchronize_full_domain(
+					&early_suspend_domain);
+				level = pos->level;
+			}
 			if (debug_mask & DEBUG_VERBOSE)
 				pr_info("late_resume: calling %pf\n", pos->resume);
 
-			pos->resume(pos);
+			if (async_handlers)
+				async_schedule_domain(async_late_resume, pos,
+						      &early_suspend_domain);
+			else
+				late_resume_call(pos);
 		}
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -198,3 +258,49 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_debug_show(struct seq_file *s, void *data)
+{
+	struct early_suspend *pos;
+
+	seq_printf(s, "level  suspend(us)  resume(us)  handler\n");
+	mutex_lock(&early_suspend_lock);
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d  %11lld  %10lld  %pf\n", pos->level,
+			   ktime_to_us(pos->suspend_time),
+			   ktime_to_us(pos->resume_time),
+			   pos->suspend ? (void *)pos->suspend :
+					  (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_debug_show, NULL);
+}
+
+static const struct file_operations early_suspend_debug_fops = {
+	.open		= early_suspend_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("early_suspend", 0444, NULL, NULL,
+		&early_suspend_debug_fops);
+	if (!d) {
+		pr_err("Failed to create early_suspend debug file\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+late_initcall(early_suspend_debug_init);
+#endif
@@ -38,11 +38,24 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_INITIALIZED            (1U << 8)
 #define WAKE_LOCK_ACTIVE                 (1U << 9)
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
-#define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * list_lock protects the lock lists, the timed lock queues, lock->flags
+ * and the sleep wait clock.  Active locks without a timeout are kept on
+ * active_wake_locks[], active locks with a timeout are kept only in
+ * timed_wake_locks[], sorted by expiry.
+ *
+ * lock->stat is owned by lock->stat.lock and published through
+ * lock->stat.seq.  Lock, unlock and destroy work out what to account
+ * under list_lock and update the statistics after dropping it, so the
+ * statistics lock is never held together with list_lock.  A lock that
+ * expires under list_lock keeps WAKE_LOCK_AUTO_EXPIRE set until the
+ * next lock, unlock or destroy claims the expiry and accounts it.
+ */
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static struct timerqueue_head timed_wake_locks[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -55,11 +68,24 @@ static struct wake_lock suspend_backoff_lock;
 
 static unsigned suspend_short_count;
 
+#define wake_lock_of(n) \
+	rb_entry((n), struct wake_lock, timer_node.node)
+
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
-static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * The sleep wait clock: total time spent with the main lock released,
+ * waiting for suspend, as of last_sleep_time_update.  A suspend lock's
+ * prevent_suspend_time is how far this clock moved while it was held,
+ * so it can be charged by the lock itself instead of walking every
+ * active lock when the main lock changes.  Protected by list_lock.
+ */
+static ktime_t sleep_wait_time;
+static ktime_t last_sleep_time_update;
+static bool sleep_waiting;
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -82,31 +108,72 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 	return 1;
 }
 
+/*
+ * The sleep wait clock at @t.  A @t before the last main lock change
+ * reads as the clock at that change.  Caller must acquire the list_lock
+ * spinlock.
+ */
+static ktime_t sleep_wait_clock(ktime_t t)
+{
+	if (!sleep_waiting ||
+	    ktime_to_ns(t) < ktime_to_ns(last_sleep_time_update))
+		return sleep_wait_time;
+	return ktime_add(sleep_wait_time,
+			 ktime_sub(t, last_sleep_time_update));
+}
+
+/* Only suspend locks are charged for the sleep wait */
+static ktime_t sleep_wait_at(struct wake_lock *lock, ktime_t t)
+{
+	if ((lock->flags & WAKE_LOCK_TYPE_MASK) != WAKE_LOCK_SUSPEND)
+		return ktime_set(0, 0);
+	return sleep_wait_clock(t);
+}
 
+/* Caller must acquire the list_lock spinlock */
+static void update_sleep_wait_locked(bool waiting, ktime_t now)
+{
+	sleep_wait_time = sleep_wait_clock(now);
+	last_sleep_time_update = now;
+	sleep_waiting = waiting;
+}
+
+/* Caller must acquire the list_lock spinlock */
 static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 {
-	int lock_count = lock->stat.count;
-	int expire_count = lock->stat.expire_count;
+	int lock_count, expire_count, wakeup_count;
 	ktime_t active_time = ktime_set(0, 0);
-	ktime_t total_time = lock->stat.total_time;
-	ktime_t max_time = lock->stat.max_time;
-
-	ktime_t prevent_suspend_time = lock->stat.prevent_suspend_time;
-	if (lock->flags & WAKE_LOCK_ACTIVE) {
+	ktime_t total_time, max_time, last_time;
+	ktime_t prevent_suspend_time, sleep_wait_start;
+	unsigned seq;
+
+	do {
+		seq = read_seqcount_begin(&lock->stat.seq);
+		lock_count = lock->stat.count;
+		expire_count = lock->stat.expire_count;
+		wakeup_count = lock->stat.wakeup_count;
+		total_time = lock->stat.total_time;
+		max_time = lock->stat.max_time;
+		last_time = lock->stat.last_time;
+		prevent_suspend_time = lock->stat.prevent_suspend_time;
+		sleep_wait_start = lock->stat.sleep_wait_start;
+	} while (read_seqcount_retry(&lock->stat.seq, seq));
+
+	if (lock->flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE)) {
 		ktime_t now, add_time;
 		int expired = get_expired_time(lock, &now);
 		if (!expired)
 			now = ktime_get();
-		add_time = ktime_sub(now, lock->stat.last_time);
+		add_time = ktime_sub(now, last_time);
 		lock_count++;
 		if (!expired)
 			active_time = add_time;
 		else
 			expire_count++;
 		total_time = ktime_add(total_time, add_time);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
-			prevent_suspend_time = ktime_add(prevent_suspend_time,
-					ktime_sub(now, last_sleep_time_update));
+		prevent_suspend_time = ktime_add(prevent_suspend_time,
+				ktime_sub(sleep_wait_at(lock, now),
+					  sleep_wait_start));
 		if (add_time.tv64 > max_time.tv64)
 			max_time = add_time;
 	}
@@ -114,16 +181,17 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 	return seq_printf(m,
 		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\n",
 		     lock->name, lock_count, expire_count,
-		     lock->stat.wakeup_count, ktime_to_ns(active_time),
+		     wakeup_count, ktime_to_ns(active_time),
 		     ktime_to_ns(total_time),
 		     ktime_to_ns(prevent_suspend_time), ktime_to_ns(max_time),
-		     ktime_to_ns(lock->stat.last_time));
+		     ktime_to_ns(last_time));
 }
 
 static int wakelock_stats_show(struct seq_file *m, void *unused)
 {
 	unsigned long irqflags;
 	struct wake_lock *lock;
+	struct rb_node *node;
 	int ret;
 	int type;
 
@@ -136,117 +204,129 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
 		list_for_each_entry(lock, &active_wake_locks[type], link)
 			ret = print_lock_stat(m, lock);
+		for (node = rb_first(&timed_wake_locks[type].head); node;
+		     node = rb_next(node))
+			ret = print_lock_stat(m, wake_lock_of(node));
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
 }
 
-static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
+/*
+ * Start and finish an update of lock->stat.  Called with interrupts
+ * disabled and without list_lock.
+ */
+static void wake_lock_stat_begin(struct wake_lock *lock)
+{
+	spin_lock(&lock->stat.lock);
+	write_seqcount_begin(&lock->stat.seq);
+}
+
+static void wake_lock_stat_end(struct wake_lock *lock)
+{
+	write_seqcount_end(&lock->stat.seq);
+	spin_unlock(&lock->stat.lock);
+}
+
+/*
+ * Account the end of a hold of @lock at @end, with the sleep wait clock
+ * at @sleep_wait.  Caller must be between wake_lock_stat_begin() and
+ * wake_lock_stat_end().
+ */
+static void wake_unlock_stat(struct wake_lock *lock, int expired, ktime_t end,
+			     ktime_t sleep_wait)
 {
 	ktime_t duration;
-	ktime_t now;
-	if (!(lock->flags & WAKE_LOCK_ACTIVE))
-		return;
-	if (get_expired_time(lock, &now))
-		expired = 1;
-	else
-		now = ktime_get();
+
 	lock->stat.count++;
 	if (expired)
 		lock->stat.expire_count++;
-	duration = ktime_sub(now, lock->stat.last_time);
+	duration = ktime_sub(end, lock->stat.last_time);
 	lock->stat.total_time = ktime_add(lock->stat.total_time, duration);
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
+	lock->stat.prevent_suspend_time =
+		ktime_add(lock->stat.prevent_suspend_time,
+			  ktime_sub(sleep_wait, lock->stat.sleep_wait_start));
 	lock->stat.last_time = ktime_get();
-	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
-		lock->stat.prevent_suspend_time = ktime_add(
-			lock->stat.prevent_suspend_time, duration);
-		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-	}
-}
-
-static void update_sleep_wait_stats_locked(int done)
-{
-	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
-
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
-	}
-	last_sleep_time_update = now;
 }
 #endif
 
 
+/* Caller must acquire the list_lock spinlock */
 static void expire_wake_lock(struct wake_lock *lock)
 {
-#ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 1);
-#endif
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
+
+	/* WAKE_LOCK_AUTO_EXPIRE stays set until the expiry is accounted */
+	lock->flags &= ~WAKE_LOCK_ACTIVE;
+	timerqueue_del(&timed_wake_locks[type], &lock->timer_node);
 	list_add(&lock->link, &inactive_locks);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
 
+/* Remove an active or inactive lock from its list or timed queue. */
+static void detach_wake_lock_locked(struct wake_lock *lock, int type)
+{
+	if ((lock->flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE)) ==
+	    (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE))
+		timerqueue_del(&timed_wake_locks[type], &lock->timer_node);
+	else
+		list_del(&lock->link);
+}
+
+static void print_active_lock(struct wake_lock *lock, bool *print_expired)
+{
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
+		long timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			pr_info("active wake lock %s, time left %ld\n",
+				lock->name, timeout);
+		else if (*print_expired)
+			pr_info("wake lock %s, expired\n", lock->name);
+	} else {
+		pr_info("active wake lock %s\n", lock->name);
+		if (!(debug_mask & DEBUG_EXPIRE))
+			*print_expired = false;
+	}
+}
+
 /* Caller must acquire the list_lock spinlock */
 static void print_active_locks(int type)
 {
 	struct wake_lock *lock;
+	struct rb_node *node;
 	bool print_expired = true;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout > 0)
-				pr_info("active wake lock %s, time left %ld\n",
-					lock->name, timeout);
-			else if (print_expired)
-				pr_info("wake lock %s, expired\n", lock->name);
-		} else {
-			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
-		}
-	}
+	list_for_each_entry(lock, &active_wake_locks[type], link)
+		print_active_lock(lock, &print_expired);
+	for (node = rb_first(&timed_wake_locks[type].head); node;
+	     node = rb_next(node))
+		print_active_lock(wake_lock_of(node), &print_expired);
 }
 
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct timerqueue_node *next;
+	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	if (!list_empty(&active_wake_locks[type]))
+		return -1;
+
+	while ((next = timerqueue_getnext(&timed_wake_locks[type]))) {
+		lock = container_of(next, struct wake_lock, timer_node);
+		if ((long)(lock->expires - jiffies) > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+	if (!next)
+		return 0;
+
+	lock = wake_lock_of(rb_last(&timed_wake_locks[type].head));
+	return lock->expires - jiffies;
 }
 
 long has_wake_lock(int type)
@@ -368,6 +448,8 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_init name=%s\n", lock->name);
 #ifdef CONFIG_WAKELOCK_STAT
+	spin_lock_init(&lock->stat.lock);
+	seqcount_init(&lock->stat.seq);
 	lock->stat.count = 0;
 	lock->stat.expire_count = 0;
 	lock->stat.wakeup_count = 0;
@@ -375,10 +457,12 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
+	lock->stat.sleep_wait_start = ktime_set(0, 0);
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
 	INIT_LIST_HEAD(&lock->link);
+	timerqueue_init(&lock->timer_node);
 	spin_lock_irqsave(&list_lock, irqflags);
 	list_add(&lock->link, &inactive_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
@@ -388,12 +472,33 @@ EXPORT_SYMBOL(wake_lock_init);
 void wake_lock_destroy(struct wake_lock *lock)
 {
 	unsigned long irqflags;
+	int type;
+#ifdef CONFIG_WAKELOCK_STAT
+	ktime_t expire_time, sleep_wait;
+	int expired;
+#endif
+
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	type = lock->flags & WAKE_LOCK_TYPE_MASK;
+	detach_wake_lock_locked(lock, type);
 #ifdef CONFIG_WAKELOCK_STAT
+	expired = !(lock->flags & WAKE_LOCK_ACTIVE) &&
+		  get_expired_time(lock, &expire_time);
+	if (expired)
+		sleep_wait = sleep_wait_at(lock, expire_time);
+#endif
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_AUTO_EXPIRE);
+	spin_unlock(&list_lock);
+#ifdef CONFIG_WAKELOCK_STAT
+	wake_lock_stat_begin(lock);
+	if (expired)
+		wake_unlock_stat(lock, 1, expire_time, sleep_wait);
 	if (lock->stat.count) {
+		spin_lock_nested(&deleted_wake_locks.stat.lock,
+				 SINGLE_DEPTH_NESTING);
+		write_seqcount_begin(&deleted_wake_locks.stat.seq);
 		deleted_wake_locks.stat.count += lock->stat.count;
 		deleted_wake_locks.stat.expire_count += lock->stat.expire_count;
 		deleted_wake_locks.stat.total_time =
@@ -405,10 +510,12 @@ void wake_lock_destroy(struct wake_lock *lock)
 		deleted_wake_locks.stat.max_time =
 			ktime_add(deleted_wake_locks.stat.max_time,
 				  lock->stat.max_time);
+		write_seqcount_end(&deleted_wake_locks.stat.seq);
+		spin_unlock(&deleted_wake_locks.stat.lock);
 	}
+	wake_lock_stat_end(lock);
 #endif
-	list_del(&lock->link);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	local_irq_restore(irqflags);
 }
 EXPORT_SYMBOL(wake_lock_destroy);
 
@@ -418,6 +525,12 @@ static void wake_lock_internal(
 	int type;
 	unsigned long irqflags;
 	long expire_in;
+#ifdef CONFIG_WAKELOCK_STAT
+	int wakeup = 0;
+	int was_active;
+	int expired;
+	ktime_t now, expire_time, sleep_wait_end, sleep_wait_start;
+#endif
 
 	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
@@ -428,21 +541,16 @@ static void wake_lock_internal(
 		if (debug_mask & DEBUG_WAKEUP)
 			pr_info("wakeup wake lock: %s\n", lock->name);
 		wait_for_wakeup = 0;
-		lock->stat.wakeup_count++;
+		wakeup = 1;
 	}
-	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
-	    (long)(lock->expires - jiffies) <= 0) {
-		wake_unlock_stat_locked(lock, 0);
-		lock->stat.last_time = ktime_get();
-	}
-#endif
-	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
-		lock->flags |= WAKE_LOCK_ACTIVE;
-#ifdef CONFIG_WAKELOCK_STAT
-		lock->stat.last_time = ktime_get();
+	now = ktime_get();
+	was_active = lock->flags & WAKE_LOCK_ACTIVE;
+	expired = get_expired_time(lock, &expire_time);
+	if (expired)
+		sleep_wait_end = sleep_wait_at(lock, expire_time);
 #endif
-	}
-	list_del(&lock->link);
+	detach_wake_lock_locked(lock, type);
+	lock->flags |= WAKE_LOCK_ACTIVE;
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
@@ -450,7 +558,9 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		/* timerqueue keys are compared as signed 64-bit values */
+		lock->timer_node.expires.tv64 = get_jiffies_64() + timeout;
+		timerqueue_add(&timed_wake_locks[type], &lock->timer_node);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
@@ -462,9 +572,7 @@ static void wake_lock_internal(
 		current_event_num++;
 #ifdef CONFIG_WAKELOCK_STAT
 		if (lock == &main_wake_lock)
-			update_sleep_wait_stats_locked(1);
-		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait_locked(false, now);
 #endif
 		if (has_timeout)
 			expire_in = has_wake_lock_locked(type);
@@ -484,7 +592,25 @@ static void wake_lock_internal(
 				queue_work(suspend_work_queue, &suspend_work);
 		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+#ifdef CONFIG_WAKELOCK_STAT
+	sleep_wait_start = sleep_wait_at(lock, now);
+#endif
+	spin_unlock(&list_lock);
+#ifdef CONFIG_WAKELOCK_STAT
+	if (wakeup || expired || !was_active) {
+		wake_lock_stat_begin(lock);
+		if (wakeup)
+			lock->stat.wakeup_count++;
+		if (expired)
+			wake_unlock_stat(lock, 1, expire_time, sleep_wait_end);
+		if (expired || !was_active) {
+			lock->stat.last_time = now;
+			lock->stat.sleep_wait_start = sleep_wait_start;
+		}
+		wake_lock_stat_end(lock);
+	}
+#endif
+	local_irq_restore(irqflags);
 }
 
 void wake_lock(struct wake_lock *lock)
@@ -503,15 +629,27 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
+#ifdef CONFIG_WAKELOCK_STAT
+	int held;
+	int expired;
+	ktime_t now, end, sleep_wait;
+#endif
+
 	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 0);
+	now = ktime_get();
+	held = lock->flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
+	expired = get_expired_time(lock, &end);
+	if (!expired)
+		end = now;
+	if (held)
+		sleep_wait = sleep_wait_at(lock, end);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	detach_wake_lock_locked(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
 	if (type == WAKE_LOCK_SUSPEND) {
 		long has_lock = has_wake_lock_locked(type);
@@ -532,11 +670,19 @@ void wake_unlock(struct wake_lock *lock)
 			if (debug_mask & DEBUG_SUSPEND)
 				print_active_locks(WAKE_LOCK_SUSPEND);
 #ifdef CONFIG_WAKELOCK_STAT
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait_locked(true, now);
 #endif
 		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock(&list_lock);
+#ifdef CONFIG_WAKELOCK_STAT
+	if (held) {
+		wake_lock_stat_begin(lock);
+		wake_unlock_stat(lock, expired, end, sleep_wait);
+		wake_lock_stat_end(lock);
+	}
+#endif
+	local_irq_restore(irqflags);
 }
 EXPORT_SYMBOL(wake_unlock);
 
@@ -564,8 +710,10 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		timerqueue_init_head(&timed_wake_locks[i]);
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -0,0 +1,152 @@
+/* kernel/power/wakelock_bench.c
+ *
+ * Cost of wake_lock()/wake_unlock() pairs.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * Loading the module runs lock/unlock pairs from one thread and from a
+ * thread bound to each online CPU, on a private lock per thread and on
+ * one lock shared by all of them, with and without a timeout, and logs
+ * the time per pair.  A suspend lock is held throughout so that the
+ * unlocks never queue a suspend.  The load then fails on purpose, so
+ * that the module can be inserted again for another run.
+ */
+
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/wakelock.h>
+
+#define BENCH_LOOPS	100000
+
+struct bench_thread {
+	struct wake_lock *lock;
+	bool timed;
+	u64 ns;
+	struct task_struct *task;
+	struct completion done;
+};
+
+static DECLARE_WAIT_QUEUE_HEAD(bench_wq);
+static bool bench_go;
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	ktime_t start;
+	int i;
+
+	wait_event(bench_wq, bench_go);
+
+	start = ktime_get();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		if (t->timed)
+			wake_lock_timeout(t->lock, HZ);
+		else
+			wake_lock(t->lock);
+		wake_unlock(t->lock);
+	}
+	t->ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	complete_and_exit(&t->done, 0);
+}
+
+static int bench_run(struct bench_thread *threads, struct wake_lock *locks,
+		     int nr, bool shared, bool timed)
+{
+	u64 total = 0, slowest = 0;
+	int cpu, i = 0;
+
+	bench_go = false;
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t;
+
+		if (i == nr)
+			break;
+		t = &threads[i];
+		t->lock = &locks[shared ? 0 : i];
+		t->timed = timed;
+		init_completion(&t->done);
+		t->task = kthread_create(bench_thread_fn, t, "wl_bench/%d", i);
+		if (IS_ERR(t->task)) {
+			while (i--)
+				kthread_stop(threads[i].task);
+			return PTR_ERR(t->task);
+		}
+		kthread_bind(t->task, cpu);
+		i++;
+	}
+	nr = i;
+
+	for (i = 0; i < nr; i++)
+		wake_up_process(threads[i].task);
+	bench_go = true;
+	smp_mb();
+	wake_up_all(&bench_wq);
+
+	for (i = 0; i < nr; i++) {
+		wait_for_completion(&threads[i].done);
+		total += threads[i].ns;
+		slowest = max(slowest, threads[i].ns);
+	}
+
+	/* throughput is all threads' pairs over the slowest thread's time */
+	printk(KERN_INFO "wakelock_bench: %-7s %-7s %2d threads: "
+	       "%5llu ns per pair, %8llu pairs/s\n",
+	       shared ? "shared" : "private", timed ? "timeout" : "untimed",
+	       nr, div64_u64(total, (u64)BENCH_LOOPS * nr),
+	       div64_u64((u64)BENCH_LOOPS * nr * NSEC_PER_SEC,
+			 max_t(u64, slowest, 1)));
+	return 0;
+}
+
+static int __init wakelock_bench_init(void)
+{
+	struct bench_thread *threads;
+	struct wake_lock *locks, guard;
+	int nr = num_online_cpus();
+	int ret = -ENOMEM;
+	int i, shared, timed;
+
+	threads = kcalloc(nr, sizeof(*threads), GFP_KERNEL);
+	locks = kcalloc(nr, sizeof(*locks), GFP_KERNEL);
+	if (!threads || !locks)
+		goto out;
+
+	wake_lock_init(&guard, WAKE_LOCK_SUSPEND, "wakelock_bench_guard");
+	wake_lock(&guard);
+	for (i = 0; i < nr; i++)
+		wake_lock_init(&locks[i], WAKE_LOCK_SUSPEND, "wakelock_bench");
+
+	for (shared = 0; shared < 2; shared++) {
+		for (timed = 0; timed < 2; timed++) {
+			ret = bench_run(threads, locks, 1, shared, timed);
+			if (!ret && nr > 1)
+				ret = bench_run(threads, locks, nr, shared,
+						timed);
+			if (ret)
+				goto destroy;
+		}
+	}
+	ret = -EAGAIN;
+
+destroy:
+	for (i = 0; i < nr; i++)
+		wake_lock_destroy(&locks[i]);
+	wake_unlock(&guard);
+	wake_lock_destroy(&guard);
+out:
+	kfree(locks);
+	kfree(threads);
+	return ret;
+}
+module_init(wakelock_bench_init);
+MODULE_DESCRIPTION("wake_lock/wake_unlock benchmark");
+MODULE_LICENSE("GPL");
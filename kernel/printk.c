@@ -41,6 +41,7 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -887,6 +888,32 @@ static inline void printk_delay(void)
 	}
 }
 
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+static int console_deferred = 1;
+module_param_named(deferred_console, console_deferred, bool, S_IRUGO | S_IWUSR);
+
+/* worst time spent in vprintk(), write 0 to reset */
+static unsigned long printk_max_latency_ns;
+module_param_named(max_latency_ns, printk_max_latency_ns, ulong,
+		   S_IRUGO | S_IWUSR);
+
+static struct task_struct *console_flush_task;
+
+/*
+ * Whether a message may be left to console_flush_task.  KERN_CRIT and
+ * more urgent messages, oopses, and whatever is printed before the
+ * thread runs or while the system goes down are still written out by
+ * the caller.
+ */
+static inline int console_may_defer(int level)
+{
+	return console_deferred && console_flush_task && !oops_in_progress &&
+		level > 2 && system_state == SYSTEM_RUNNING;
+}
+
+static void defer_console_output(void);
+#endif
+
 asmlinkage int vprintk(const char *fmt, va_list args)
 {
 	int printed_len = 0;
@@ -896,10 +923,16 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	char *p;
 	size_t plen;
 	char special;
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+	u64 start, latency;
+#endif
 
 	boot_delay_msec();
 	printk_delay();
 
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+	start = local_clock();
+#endif
 	preempt_disable();
 	/* This stops the holder of console_sem just where we want him */
 	raw_local_irq_save(flags);
@@ -1020,7 +1053,17 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	 * The console_trylock_for_printk() function
 	 * will release 'logbuf_lock' regardless of whether it
 	 * actually gets the semaphore or not.
+	 *
+	 * In deferred mode the consoles are left to console_flush_task,
+	 * so slow consoles don't hold up the caller.
 	 */
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+	if (console_may_defer(current_log_level)) {
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		defer_console_output();
+	} else
+#endif
 	if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
@@ -1029,6 +1072,11 @@ out_restore_irqs:
 	raw_local_irq_restore(flags);
 
 	preempt_enable();
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+	latency = local_clock() - start;
+	if (latency > printk_max_latency_ns)
+		printk_max_latency_ns = latency;
+#endif
 	return printed_len;
 }
 EXPORT_SYMBOL(printk);
@@ -1268,13 +1316,23 @@ int is_console_locked(void)
 	return console_locked;
 }
 
+#define PRINTK_PENDING_WAKEUP	0x01
+#define PRINTK_PENDING_FLUSH	0x02
+
 static DEFINE_PER_CPU(int, printk_pending);
 
 void printk_tick(void)
 {
 	if (__this_cpu_read(printk_pending)) {
+		int pending = __this_cpu_read(printk_pending);
+
 		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+		if (pending & PRINTK_PENDING_FLUSH)
+			wake_up_process(console_flush_task);
+#endif
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
 	}
 }
 
@@ -1288,9 +1346,38 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
 }
 
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+/*
+ * printk() may be called with the runqueue lock held, so the flush
+ * thread is woken from the next timer tick rather than from here.
+ */
+static void defer_console_output(void)
+{
+	this_cpu_or(printk_pending, PRINTK_PENDING_FLUSH);
+	wake_up_klogd();
+}
+
+static int console_flush_thread(void *unused)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		/* resume_console() flushes what was held back meanwhile */
+		if (con_start == log_end || console_suspended)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/* console_unlock() writes out everything pending */
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+#endif
+
 /**
  * console_unlock - unlock the console system
  *
@@ -1658,6 +1745,12 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+#ifdef CONFIG_PRINTK_DEFERRED_CONSOLE
+	console_flush_task = kthread_run(console_flush_thread, NULL,
+					 "kconsoled");
+	if (IS_ERR(console_flush_task))
+		console_flush_task = NULL;
+#endif
 	return 0;
 }
 late_initcall(printk_late_init);
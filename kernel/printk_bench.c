@@ -0,0 +1,81 @@
+/*
+ * kernel/printk_bench.c
+ *
+ * Time spent in printk() by the caller, with the consoles written out
+ * synchronously and with them left to kconsoled.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * Loading the module prints a burst of lines at KERN_CRIT, which are
+ * always written out by the caller, and then the same burst at KERN_INFO,
+ * which CONFIG_PRINTK_DEFERRED_CONSOLE leaves to kconsoled unless
+ * printk.deferred_console=0.  It logs the mean, median, 99th percentile
+ * and worst time per call of each burst.  The console loglevel has to
+ * let KERN_INFO through for the comparison to mean anything.  The load
+ * then fails on purpose, so that the module can be inserted again for
+ * another run.
+ */
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+
+#define BENCH_LINES	200
+
+static int bench_cmp(const void *a, const void *b)
+{
+	const u64 *x = a, *y = b;
+
+	if (*x < *y)
+		return -1;
+	return *x > *y;
+}
+
+static void bench_burst(u64 *ns, bool crit)
+{
+	u64 start, total = 0;
+	int i;
+
+	for (i = 0; i < BENCH_LINES; i++) {
+		start = local_clock();
+		if (crit)
+			printk(KERN_CRIT "printk_bench: sync line %3d, "
+			       "padded to a typical message length\n", i);
+		else
+			printk(KERN_INFO "printk_bench: info line %3d, "
+			       "padded to a typical message length\n", i);
+		ns[i] = local_clock() - start;
+		total += ns[i];
+	}
+
+	sort(ns, BENCH_LINES, sizeof(*ns), bench_cmp, NULL);
+	printk(KERN_INFO "printk_bench: %-4s %d lines: mean %llu ns, "
+	       "median %llu ns, p99 %llu ns, max %llu ns\n",
+	       crit ? "crit" : "info", BENCH_LINES,
+	       div64_u64(total, BENCH_LINES), ns[BENCH_LINES / 2],
+	       ns[BENCH_LINES * 99 / 100], ns[BENCH_LINES - 1]);
+}
+
+static int __init printk_bench_init(void)
+{
+	u64 *ns;
+
+	ns = kcalloc(BENCH_LINES, sizeof(*ns), GFP_KERNEL);
+	if (!ns)
+		return -ENOMEM;
+
+	/* synchronous first, so the deferred backlog can't add to it */
+	bench_burst(ns, true);
+	bench_burst(ns, false);
+
+	kfree(ns);
+	return -EAGAIN;
+}
+module_init(printk_bench_init);
+MODULE_DESCRIPTION("printk caller latency benchmark");
+MODULE_LICENSE("GPL");
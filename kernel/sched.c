@@ -72,6 +72,7 @@
 #include <linux/ftrace.h>
 #include <linux/slab.h>
 #include <linux/cpuacct.h>
+#include <linux/cpufreq.h>
 
 #include <asm/tlb.h>
 #include <asm/irq_regs.h>
@@ -3737,6 +3738,7 @@ void account_user_time(struct task_struct *p, cputime_t cputime,
 		cpustat->user = cputime64_add(cpustat->user, tmp);
 
 	cpuacct_update_stats(p, CPUACCT_STAT_USER, cputime);
+	cpufreq_stats_account_uid(p, cputime);
 	/* Account for user time used */
 	acct_update_integrals(p);
 }
@@ -3792,6 +3794,7 @@ void __account_system_time(struct task_struct *p, cputime_t cputime,
 	/* Add system time to cpustat. */
 	*target_cputime64 = cputime64_add(*target_cputime64, tmp);
 	cpuacct_update_stats(p, CPUACCT_STAT_SYSTEM, cputime);
+	cpufreq_stats_account_uid(p, cputime);
 
 	/* Account for system time used */
 	acct_update_integrals(p);
@@ -26,15 +26,22 @@
 #include <linux/compiler.h>
 #include <linux/types.h>
 #include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+#include <linux/slab.h>
 #include <asm/atomic.h>
+#ifdef CONFIG_CRC32_NEON
+#include <asm/neon.h>
+#endif
 #include "crc32defs.h"
-#if CRC_LE_BITS == 8
+#if CRC_LE_BITS >= 8
 # define tole(x) __constant_cpu_to_le32(x)
 #else
 # define tole(x) (x)
 #endif
 
-#if CRC_BE_BITS == 8
+#if CRC_BE_BITS >= 8
 # define tobe(x) __constant_cpu_to_be32(x)
 #else
 # define tobe(x) (x)
@@ -45,10 +52,17 @@ MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
 MODULE_DESCRIPTION("Ethernet CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
+#if CRC_LE_BITS >= 8 || CRC_BE_BITS >= 8
 
+/*
+ * Table driven CRC of a buffer, one byte at a time until buf is aligned
+ * and then "slices" (4 or 8) bytes at a time.  Table j gives the CRC of
+ * a byte followed by j zero bytes, so a whole slice is folded into crc
+ * with one lookup per byte.
+ */
 static inline u32
-crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
+crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256],
+	   int slices)
 {
 # ifdef __LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
@@ -56,15 +70,32 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 		tab[2][(crc >> 8) & 255] ^ \
 		tab[1][(crc >> 16) & 255] ^ \
 		tab[0][(crc >> 24) & 255]
+#  define DO_CRC8a(q) crc = tab[7][(q) & 255] ^ \
+		tab[6][((q) >> 8) & 255] ^ \
+		tab[5][((q) >> 16) & 255] ^ \
+		tab[4][((q) >> 24) & 255]
+#  define DO_CRC8b(q) crc ^= tab[3][(q) & 255] ^ \
+		tab[2][((q) >> 8) & 255] ^ \
+		tab[1][((q) >> 16) & 255] ^ \
+		tab[0][((q) >> 24) & 255]
 # else
 #  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
 #  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
 		tab[1][(crc >> 8) & 255] ^ \
 		tab[2][(crc >> 16) & 255] ^ \
 		tab[3][(crc >> 24) & 255]
+#  define DO_CRC8a(q) crc = tab[4][(q) & 255] ^ \
+		tab[5][((q) >> 8) & 255] ^ \
+		tab[6][((q) >> 16) & 255] ^ \
+		tab[7][((q) >> 24) & 255]
+#  define DO_CRC8b(q) crc ^= tab[0][(q) & 255] ^ \
+		tab[1][((q) >> 8) & 255] ^ \
+		tab[2][((q) >> 16) & 255] ^ \
+		tab[3][((q) >> 24) & 255]
 # endif
 	const u32 *b;
 	size_t    rem_len;
+	u32	  q;
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -72,13 +103,25 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 			DO_CRC(*buf++);
 		} while ((--len) && ((long)buf)&3);
 	}
-	rem_len = len & 3;
-	/* load data 32 bits wide, xor data 32 bits wide. */
-	len = len >> 2;
 	b = (const u32 *)buf;
-	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+	if (slices == 8) {
+		rem_len = len & 7;
+		/* load data 64 bits wide, each word through its 4 tables */
+		len = len >> 3;
+		for (--b; len; --len) {
+			q = crc ^ *++b;
+			DO_CRC8a(q);
+			q = *++b;
+			DO_CRC8b(q);
+		}
+	} else {
+		rem_len = len & 3;
+		/* load data 32 bits wide, xor data 32 bits wide. */
+		len = len >> 2;
+		for (--b; len; --len) {
+			crc ^= *++b; /* use pre increment for speed */
+			DO_CRC4;
+		}
 	}
 	len = rem_len;
 	/* And the last few bytes */
@@ -91,8 +134,186 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	return crc;
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8a
+#undef DO_CRC8b
+}
+#endif
+
+#if CRC_LE_BITS == 64 || CRC_BE_BITS == 64
+typedef u32 (*crc32_body_fn)(u32 crc, unsigned char const *p, size_t len);
+#endif
+
+#if CRC_LE_BITS == 64
+static u32 __pure crc32_le_slice4(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_body(crc, p, len, crc32table_le, 4);
+}
+
+static u32 __pure crc32_le_slice8(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_body(crc, p, len, crc32table_le, 8);
+}
+
+/* Both give the same result, crc32_init() keeps the faster one */
+static crc32_body_fn crc32_le_body __read_mostly = crc32_le_slice8;
+#endif
+
+#if CRC_BE_BITS == 64
+static u32 __pure crc32_be_slice4(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_body(crc, p, len, crc32table_be, 4);
+}
+
+static u32 __pure crc32_be_slice8(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_body(crc, p, len, crc32table_be, 8);
 }
+
+static crc32_body_fn crc32_be_body __read_mostly = crc32_be_slice8;
 #endif
+
+#ifdef CONFIG_CRC32_NEON
+/*
+ * Below this many bytes setting up the streams and folding them back
+ * together costs more than the NEON loop saves.
+ */
+#define CRC32_NEON_MIN		512
+#define CRC32_NEON_STREAMS	8
+
+extern void __crc32_neon(u8 state[4][8], const u8 *buf, size_t stride,
+			 size_t blocks, const u8 tables[8][16]);
+
+static u8 crc32_neon_le_tables[8][16] __read_mostly;
+static u8 crc32_neon_be_tables[8][16] __read_mostly;
+
+/* The slicing crc32_init() chose, for short buffers and the tail */
+static crc32_body_fn crc32_le_table_body __read_mostly = crc32_le_slice8;
+static crc32_body_fn crc32_be_table_body __read_mostly = crc32_be_slice8;
+
+/* a * b mod P, both bit reflected as in crc32_le() */
+static u32 crc32_le_mulmod(u32 a, u32 b)
+{
+	u32 p = 0;
+	int i;
+
+	for (i = 31; i >= 0; i--) {
+		if (a & (1U << i))
+			p ^= b;
+		b = (b >> 1) ^ ((b & 1) ? CRCPOLY_LE : 0);
+	}
+	return p;
+}
+
+/* a * b mod P, msbit first as in crc32_be() */
+static u32 crc32_be_mulmod(u32 a, u32 b)
+{
+	u32 p = 0;
+	int i;
+
+	for (i = 31; i >= 0; i--) {
+		p = (p << 1) ^ ((p & 0x80000000) ? CRCPOLY_BE : 0);
+		if (a & (1U << i))
+			p ^= b;
+	}
+	return p;
+}
+
+/*
+ * Without the pre and post inversion crc(c, a.b) is
+ * crc(c, a) * x^(8 * len(b)) ^ crc(0, b), so streams hashed separately
+ * can be chained with one multiplication each.
+ */
+static u32 crc32_neon(u32 crc, unsigned char const *p, size_t len, bool be)
+{
+	u32 (*mulmod)(u32, u32) = be ? crc32_be_mulmod : crc32_le_mulmod;
+	crc32_body_fn tail = be ? crc32_be_table_body : crc32_le_table_body;
+	u8 state[4][CRC32_NEON_STREAMS];
+	size_t blocks, stride, n;
+	u32 x8n, base, c;
+	int s, k;
+
+	if (len < CRC32_NEON_MIN || !kernel_neon_usable())
+		return tail(crc, p, len);
+
+	blocks = len / (8 * CRC32_NEON_STREAMS);
+	stride = blocks * 8;
+
+	/* plane 0 is the byte the data is folded into */
+	c = be ? __be32_to_cpu(crc) : __le32_to_cpu(crc);
+	memset(state, 0, sizeof(state));
+	for (k = 0; k < 4; k++)
+		state[be ? 3 - k : k][0] = c >> (8 * k);
+
+	kernel_neon_begin();
+	__crc32_neon(state, p, stride, blocks,
+		     be ? crc32_neon_be_tables : crc32_neon_le_tables);
+	kernel_neon_end();
+
+	/* x^(8 * stride) mod P, by squaring x^8 */
+	x8n = be ? 1 : 0x80000000;
+	base = be ? 0x100 : 0x00800000;
+	for (n = stride; n; n >>= 1) {
+		if (n & 1)
+			x8n = mulmod(x8n, base);
+		base = mulmod(base, base);
+	}
+
+	c = 0;
+	for (s = 0; s < CRC32_NEON_STREAMS; s++) {
+		u32 cs = 0;
+
+		for (k = 0; k < 4; k++)
+			cs |= (u32)state[be ? 3 - k : k][s] << (8 * k);
+		c = mulmod(c, x8n) ^ cs;
+	}
+
+	crc = be ? __cpu_to_be32(c) : __cpu_to_le32(c);
+	n = stride * CRC32_NEON_STREAMS;
+	return tail(crc, p + n, len - n);
+}
+
+static u32 crc32_le_neon(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon(crc, p, len, false);
+}
+
+static u32 crc32_be_neon(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_neon(crc, p, len, true);
+}
+
+/*
+ * Split the byte table into low and high nibble tables, and those into
+ * byte planes, in the order __crc32_neon() walks its planes.
+ */
+static void __init crc32_neon_init_tables(void)
+{
+	u32 le, be;
+	int n, k, i;
+
+	for (n = 0; n < 16; n++) {
+		for (i = 0; i < 2; i++) {
+			u8 byte = i ? n << 4 : n;
+
+			le = byte;
+			be = byte << 24;
+			for (k = 0; k < 8; k++) {
+				le = (le >> 1) ^ ((le & 1) ? CRCPOLY_LE : 0);
+				be = (be << 1) ^
+				     ((be & 0x80000000) ? CRCPOLY_BE : 0);
+			}
+			for (k = 0; k < 4; k++) {
+				crc32_neon_le_tables[2 * k + i][n] =
+					le >> (8 * k);
+				crc32_neon_be_tables[2 * k + i][n] =
+					be >> (8 * (3 - k));
+			}
+		}
+	}
+	smp_wmb();	/* before the body pointers that use them */
+}
+#endif
+
 /**
  * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
  * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
@@ -122,11 +343,15 @@ u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 
 u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_LE_BITS == 8
+# if CRC_LE_BITS == 64
+	crc = __cpu_to_le32(crc);
+	crc = crc32_le_body(crc, p, len);
+	return __le32_to_cpu(crc);
+# elif CRC_LE_BITS == 8
 	const u32      (*tab)[] = crc32table_le;
 
 	crc = __cpu_to_le32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = crc32_body(crc, p, len, tab, 4);
 	return __le32_to_cpu(crc);
 # elif CRC_LE_BITS == 4
 	while (len--) {
@@ -179,11 +404,15 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 #else				/* Table-based approach */
 u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_BE_BITS == 8
+# if CRC_BE_BITS == 64
+	crc = __cpu_to_be32(crc);
+	crc = crc32_be_body(crc, p, len);
+	return __be32_to_cpu(crc);
+# elif CRC_BE_BITS == 8
 	const u32      (*tab)[] = crc32table_be;
 
 	crc = __cpu_to_be32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = crc32_body(crc, p, len, tab, 4);
 	return __be32_to_cpu(crc);
 # elif CRC_BE_BITS == 4
 	while (len--) {
@@ -208,6 +437,213 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 EXPORT_SYMBOL(crc32_le);
 EXPORT_SYMBOL(crc32_be);
 
+#if CRC_LE_BITS == 64 || CRC_BE_BITS == 64 || defined(CONFIG_CRC32_SELFTEST)
+
+#define CRC32_TEST_LEN	4096
+
+static u32 crc32_sink;
+
+/*
+ * Best of a few runs of hashing len bytes of buf count times, in ns.
+ * The result goes to crc32_sink so the calls can't be dropped.
+ */
+static u64 __init crc32_time(u32 (*fn)(u32, unsigned char const *, size_t),
+			     const u8 *buf, size_t len, int count)
+{
+	u64 best = ULLONG_MAX, ns;
+	ktime_t start;
+	u32 crc = 0;
+	int run, i;
+
+	for (run = 0; run < 4; run++) {
+		start = ktime_get();
+		for (i = 0; i < count; i++)
+			crc = fn(crc, buf, len);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (ns < best)
+			best = ns;
+	}
+	crc32_sink = crc;
+	return best;
+}
+#endif
+
+#if CRC_LE_BITS == 64 || CRC_BE_BITS == 64
+/*
+ * Slice-by-8 halves the number of loop iterations, but walks twice the
+ * table space of slice-by-4.  On processors with a small data cache that
+ * can cost more than it gains, so time both and keep the faster one.
+ */
+static crc32_body_fn __init crc32_select(const char *name, crc32_body_fn slice4,
+					 crc32_body_fn slice8, const u8 *buf)
+{
+	u64 t4, t8;
+
+	t4 = crc32_time(slice4, buf, CRC32_TEST_LEN, 8);
+	t8 = crc32_time(slice8, buf, CRC32_TEST_LEN, 8);
+	pr_info("crc32: %s using slice-by-%d (%llu vs %llu ns)\n", name,
+		t8 <= t4 ? 8 : 4, t8 <= t4 ? t8 : t4, t8 <= t4 ? t4 : t8);
+
+	return t8 <= t4 ? slice8 : slice4;
+}
+#endif
+
+#ifdef CONFIG_CRC32_NEON
+/*
+ * The NEON loop has a longer dependency chain per byte than the integer
+ * one and only wins where the vector unit keeps up with it, so it also
+ * has to earn its place against the chosen slicing.
+ */
+static crc32_body_fn __init crc32_select_neon(const char *name,
+					      crc32_body_fn table,
+					      crc32_body_fn neon, const u8 *buf)
+{
+	u64 tt, tn;
+
+	tt = crc32_time(table, buf, CRC32_TEST_LEN, 8);
+	tn = crc32_time(neon, buf, CRC32_TEST_LEN, 8);
+	pr_info("crc32: %s using %s (%llu vs %llu ns)\n", name,
+		tn < tt ? "neon" : "tables", tn < tt ? tn : tt,
+		tn < tt ? tt : tn);
+
+	return tn < tt ? neon : table;
+}
+#endif
+
+#ifdef CONFIG_CRC32_SELFTEST
+static u32 __init crc32_le_bitwise(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+	}
+	return crc;
+}
+
+static u32 __init crc32_be_bitwise(u32 crc, unsigned char const *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+			      ((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+/*
+ * Compare crc32_le() and crc32_be() with the bitwise references for
+ * every alignment and a spread of lengths and seeds, then log their
+ * throughput.  Returns the number of mismatches.
+ */
+static int __init crc32_test(const char *name, const u8 *buf)
+{
+	static const size_t lens[] __initconst = { 1, 16, 64, 256, 1024, 4096 };
+	static const u32 seeds[] __initconst = { 0, ~0, 0x12345678 };
+	int errors = 0;
+	size_t off, len;
+	u64 ns;
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(seeds); i++) {
+		for (off = 0; off < 8; off++) {
+			for (len = 0; len <= CRC32_TEST_LEN - 8;
+			     len += len < 80 ? 1 : 509) {
+				if (crc32_le(seeds[i], buf + off, len) !=
+				    crc32_le_bitwise(seeds[i], buf + off, len))
+					errors++;
+				if (crc32_be(seeds[i], buf + off, len) !=
+				    crc32_be_bitwise(seeds[i], buf + off, len))
+					errors++;
+			}
+		}
+	}
+	if (errors)
+		pr_err("crc32: %s: %d mismatches\n", name, errors);
+
+	for (j = 0; j < ARRAY_SIZE(lens); j++) {
+		ns = crc32_time(crc32_le, buf, lens[j], 64) ?: 1;
+		pr_info("crc32: %s: le %5zu bytes: %llu MB/s\n", name, lens[j],
+			div64_u64((u64)lens[j] * 64 * 1000, ns));
+		ns = crc32_time(crc32_be, buf, lens[j], 64) ?: 1;
+		pr_info("crc32: %s: be %5zu bytes: %llu MB/s\n", name, lens[j],
+			div64_u64((u64)lens[j] * 64 * 1000, ns));
+	}
+
+	return errors;
+}
+#endif
+
+#if CRC_LE_BITS == 64 || CRC_BE_BITS == 64 || defined(CONFIG_CRC32_SELFTEST)
+static int __init crc32_init(void)
+{
+	u8 *buf;
+	int i;
+
+	buf = kmalloc(CRC32_TEST_LEN, GFP_KERNEL);
+	if (!buf)
+		return 0;
+	for (i = 0; i < CRC32_TEST_LEN; i++)
+		buf[i] = random32();
+
+#ifdef CONFIG_CRC32_SELFTEST
+	/*
+	 * Both slicings give the same CRC, so swapping them under running
+	 * users is harmless.
+	 */
+# if CRC_LE_BITS == 64 && CRC_BE_BITS == 64
+	crc32_le_body = crc32_le_slice4;
+	crc32_be_body = crc32_be_slice4;
+	crc32_test("slice-by-4", buf);
+	crc32_le_body = crc32_le_slice8;
+	crc32_be_body = crc32_be_slice8;
+	crc32_test("slice-by-8", buf);
+#  ifdef CONFIG_CRC32_NEON
+	if (cpu_has_neon()) {
+		crc32_neon_init_tables();
+		crc32_le_body = crc32_le_neon;
+		crc32_be_body = crc32_be_neon;
+		crc32_test("neon", buf);
+	}
+#  endif
+# else
+	crc32_test("crc32", buf);
+# endif
+#endif
+
+#if CRC_LE_BITS == 64
+	crc32_le_body = crc32_select("le", crc32_le_slice4, crc32_le_slice8,
+				     buf);
+#endif
+#if CRC_BE_BITS == 64
+	crc32_be_body = crc32_select("be", crc32_be_slice4, crc32_be_slice8,
+				     buf);
+#endif
+#ifdef CONFIG_CRC32_NEON
+	/* crc32_le_neon() itself uses the table code until this is set */
+	crc32_le_table_body = crc32_le_body;
+	crc32_be_table_body = crc32_be_body;
+	if (cpu_has_neon()) {
+		crc32_neon_init_tables();
+		crc32_le_body = crc32_select_neon("le", crc32_le_table_body,
+						  crc32_le_neon, buf);
+		crc32_be_body = crc32_select_neon("be", crc32_be_table_body,
+						  crc32_be_neon, buf);
+	}
+#endif
+
+	kfree(buf);
+	return 0;
+}
+/* late, so that the VFP code has reported NEON in elf_hwcap */
+late_initcall(crc32_init);
+#endif
+
 /*
  * A brief CRC tutorial.
  *
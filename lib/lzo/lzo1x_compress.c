@@ -43,11 +43,11 @@ literal:
 next:
 		if (unlikely(ip >= ip_end))
 			break;
-		dv = get_unaligned_le32(ip);
+		dv = LOAD4_LE(ip);
 		t = ((dv * 0x1824429d) >> (32 - D_BITS)) & D_MASK;
 		m_pos = in + dict[t];
 		dict[t] = (lzo_dict_t) (ip - in);
-		if (unlikely(dv != get_unaligned_le32(m_pos)))
+		if (unlikely(dv != LOAD4_LE(m_pos)))
 			goto literal;
 
 		ii -= ti;
@@ -82,9 +82,16 @@ next:
 					ii += 16;
 					t -= 16;
 				} while (t >= 16);
-				if (t > 0) do {
-					*op++ = *ii++;
-				} while (--t > 0);
+				/*
+				 * At least the match code, the 20 byte tail of
+				 * the input and the end marker follow, so the
+				 * output has room for writing past the run.
+				 */
+				if (t > 0) {
+					COPY8(op, ii);
+					COPY8(op + 8, ii + 8);
+					op += t;
+				}
 			}
 		}
 
@@ -112,18 +119,15 @@ next:
 #  endif
 #elif defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) && defined(LZO_USE_CTZ32)
 		u32 v;
-		v = get_unaligned((const u32 *) (ip + m_len)) ^
-		    get_unaligned((const u32 *) (m_pos + m_len));
+		v = LOAD4(ip + m_len) ^ LOAD4(m_pos + m_len);
 		if (unlikely(v == 0)) {
 			do {
 				m_len += 4;
-				v = get_unaligned((const u32 *) (ip + m_len)) ^
-				    get_unaligned((const u32 *) (m_pos + m_len));
+				v = LOAD4(ip + m_len) ^ LOAD4(m_pos + m_len);
 				if (v != 0)
 					break;
 				m_len += 4;
-				v = get_unaligned((const u32 *) (ip + m_len)) ^
-				    get_unaligned((const u32 *) (m_pos + m_len));
+				v = LOAD4(ip + m_len) ^ LOAD4(m_pos + m_len);
 				if (unlikely(ip + m_len >= ip_end))
 					goto m_len_done;
 			} while (v == 0);
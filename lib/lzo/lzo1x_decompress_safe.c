@@ -201,6 +201,15 @@ copy_literal_run:
 					*op++ = *m_pos++;
 				} while (op < oe);
 			}
+		} else if (op - m_pos >= 4 && likely(HAVE_OP(t, 3))) {
+			/* Short distance, each word only reads written bytes */
+			unsigned char *oe = op + t;
+			do {
+				COPY4(op, m_pos);
+				op += 4;
+				m_pos += 4;
+			} while (op < oe);
+			op = oe;
 		} else
 #endif
 		{
@@ -0,0 +1,204 @@
+/*
+ *  LZO1X compression and decompression throughput
+ *
+ *  Loading the module compresses and decompresses a small generated
+ *  corpus page by page, the way zram uses LZO, checks the round trip
+ *  and logs ratio and MB/s for each kind of data.  The load then fails
+ *  on purpose, so that the module can be inserted again for another run.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lzo.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <asm/div64.h>
+
+#define BENCH_PAGES	64
+#define BENCH_SIZE	(BENCH_PAGES * PAGE_SIZE)
+#define BENCH_ROUNDS	32
+
+static const char * const bench_words[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "it", "as",
+	"with", "was", "on", "be", "at", "by", "this", "had", "not", "are",
+	"but", "from", "or", "have", "an", "they", "which", "one", "you",
+	"were", "her", "all", "she", "there", "would", "their", "we", "him",
+	"been", "has", "when", "who", "will", "more", "no", "if", "out",
+	"kernel", "memory", "page", "device", "android", "system", "file",
+};
+
+static u32 bench_seed;
+
+static u32 bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return bench_seed >> 8;
+}
+
+static void fill_text(unsigned char *buf, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len) {
+		const char *w;
+
+		w = bench_words[bench_rand() % ARRAY_SIZE(bench_words)];
+		while (*w && i < len)
+			buf[i++] = *w++;
+		if (i < len)
+			buf[i++] = bench_rand() % 11 ? ' ' : '\n';
+	}
+}
+
+/* Mostly zero words with some pointers and counters, like anon memory */
+static void fill_sparse(unsigned char *buf, size_t len)
+{
+	u32 *p = (u32 *)buf;
+	size_t i;
+
+	for (i = 0; i < len / 4; i++) {
+		u32 r = bench_rand();
+
+		if (r % 4 == 0)
+			p[i] = 0xc0000000 | (r & 0x00fffffc);
+		else if (r % 4 == 1)
+			p[i] = r & 0xff;
+		else
+			p[i] = 0;
+	}
+}
+
+static void fill_code(unsigned char *buf, size_t len)
+{
+	const unsigned char *text = THIS_MODULE->module_core;
+	size_t text_len = THIS_MODULE->core_text_size;
+	size_t i;
+
+	for (i = 0; i < len; i += text_len)
+		memcpy(buf + i, text, min(text_len, len - i));
+}
+
+static void fill_zero(unsigned char *buf, size_t len)
+{
+	memset(buf, 0, len);
+}
+
+static void fill_random(unsigned char *buf, size_t len)
+{
+	get_random_bytes(buf, len);
+}
+
+static const struct {
+	const char *name;
+	void (*fill)(unsigned char *buf, size_t len);
+} bench_corpus[] = {
+	{ "text",	fill_text },
+	{ "sparse",	fill_sparse },
+	{ "code",	fill_code },
+	{ "zero",	fill_zero },
+	{ "random",	fill_random },
+};
+
+static unsigned long bench_mbps(u64 bytes, u64 ns)
+{
+	bytes *= 1000;
+	do_div(bytes, max_t(u64, ns, 1));
+	return bytes;
+}
+
+static int __init lzo_bench_run(const char *name, unsigned char *src,
+				unsigned char *dst, unsigned char *back,
+				void *wrkmem)
+{
+	size_t clen[BENCH_PAGES];
+	size_t total = 0;
+	u64 comp_ns, decomp_ns;
+	ktime_t start;
+	int round, i, ret;
+
+	start = ktime_get();
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		for (i = 0; i < BENCH_PAGES; i++) {
+			clen[i] = lzo1x_worst_compress(PAGE_SIZE);
+			ret = lzo1x_1_compress(src + i * PAGE_SIZE, PAGE_SIZE,
+				dst + i * lzo1x_worst_compress(PAGE_SIZE),
+				&clen[i], wrkmem);
+			if (ret != LZO_E_OK)
+				goto fail;
+		}
+		cond_resched();
+	}
+	comp_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		for (i = 0; i < BENCH_PAGES; i++) {
+			size_t len = PAGE_SIZE;
+
+			ret = lzo1x_decompress_safe(
+				dst + i * lzo1x_worst_compress(PAGE_SIZE),
+				clen[i], back + i * PAGE_SIZE, &len);
+			if (ret != LZO_E_OK || len != PAGE_SIZE)
+				goto fail;
+		}
+		cond_resched();
+	}
+	decomp_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (memcmp(src, back, BENCH_SIZE)) {
+		ret = LZO_E_ERROR;
+		goto fail;
+	}
+
+	for (i = 0; i < BENCH_PAGES; i++)
+		total += clen[i];
+
+	printk(KERN_INFO "lzo_bench: %-6s %3zu%% compress %5lu MB/s "
+	       "decompress %5lu MB/s\n", name,
+	       (size_t)(total * 100 / BENCH_SIZE),
+	       bench_mbps((u64)BENCH_SIZE * BENCH_ROUNDS, comp_ns),
+	       bench_mbps((u64)BENCH_SIZE * BENCH_ROUNDS, decomp_ns));
+	return 0;
+
+fail:
+	printk(KERN_ERR "lzo_bench: %s page %d failed: %d\n", name, i, ret);
+	return -EINVAL;
+}
+
+static int __init lzo_bench_init(void)
+{
+	unsigned char *src, *dst, *back;
+	void *wrkmem;
+	int i, ret = -ENOMEM;
+
+	src = vmalloc(BENCH_SIZE);
+	back = vmalloc(BENCH_SIZE);
+	dst = vmalloc(BENCH_PAGES * lzo1x_worst_compress(PAGE_SIZE));
+	wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	if (!src || !dst || !back || !wrkmem)
+		goto out;
+
+	bench_seed = 1;
+	for (i = 0; i < ARRAY_SIZE(bench_corpus); i++) {
+		bench_corpus[i].fill(src, BENCH_SIZE);
+		ret = lzo_bench_run(bench_corpus[i].name, src, dst, back,
+				    wrkmem);
+		if (ret)
+			goto out;
+	}
+	ret = -EAGAIN;
+
+out:
+	vfree(wrkmem);
+	vfree(dst);
+	vfree(back);
+	vfree(src);
+	return ret;
+}
+module_init(lzo_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X throughput benchmark");
@@ -14,12 +14,33 @@
 
 #if 1 && defined(__arm__) && ((__LINUX_ARM_ARCH__ >= 6) || defined(__ARM_FEATURE_UNALIGNED))
 #define CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS 1
-#define COPY4(dst, src)	\
-		* (u32 *) (void *) (dst) = * (const u32 *) (const void *) (src)
+/*
+ * ARMv6 and later do unaligned word loads and stores in hardware, but
+ * get_unaligned() is byte-wise here, and plain u32 dereferences may be
+ * merged by the compiler into ldm/ldrd, which still trap on unaligned
+ * addresses.  So spell out single ldr/str.
+ */
+static __always_inline u32 lzo_load32(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "m" (*(const u32 *)p));
+	return v;
+}
+
+static __always_inline void lzo_store32(void *p, u32 v)
+{
+	asm("str	%1, %0" : "=m" (*(u32 *)p) : "r" (v));
+}
+
+#define LOAD4(src)	lzo_load32(src)
+#define COPY4(dst, src)	lzo_store32(dst, lzo_load32(src))
 #else
+#define LOAD4(src)	get_unaligned((const u32 *)(src))
 #define COPY4(dst, src)	\
 		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
 #endif
+#define LOAD4_LE(src)	le32_to_cpu((__force __le32)LOAD4(src))
 #if defined(__x86_64__)
 #define COPY8(dst, src)	\
 		put_unaligned(get_unaligned((const u64 *)(src)), (u64 *)(dst))
@@ -7,6 +7,7 @@
  *
  * Copyright IBM Corp. 2007-2010 Mel Gorman <mel@csn.ul.ie>
  */
+#include <linux/module.h>
 #include <linux/swap.h>
 #include <linux/migrate.h>
 #include <linux/compaction.h>
@@ -14,6 +15,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -38,6 +41,9 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	bool bounded;			/* Background compaction by kcompactd */
+	unsigned long budget;		/* Isolation rounds left if bounded */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -573,12 +579,29 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
 	cc->free_pfn &= ~(pageblock_nr_pages-1);
 
+	/* Bounded compaction resumes where the previous run stopped */
+	if (cc->bounded &&
+	    zone->compact_cached_migrate_pfn >= cc->migrate_pfn &&
+	    zone->compact_cached_free_pfn <= cc->free_pfn &&
+	    zone->compact_cached_migrate_pfn < zone->compact_cached_free_pfn) {
+		cc->migrate_pfn = zone->compact_cached_migrate_pfn;
+		cc->free_pfn = zone->compact_cached_free_pfn;
+	}
+
 	migrate_prep_local();
 
 	while ((ret = compact_finished(zone, cc)) == COMPACT_CONTINUE) {
 		unsigned long nr_migrate, nr_remaining;
 		int err;
 
+		if (cc->bounded) {
+			if (!cc->budget) {
+				ret = COMPACT_PARTIAL;
+				goto out;
+			}
+			cc->budget--;
+		}
+
 		switch (isolate_migratepages(zone, cc)) {
 		case ISOLATE_ABORT:
 			ret = COMPACT_PARTIAL;
@@ -619,6 +642,16 @@ out:
 	cc->nr_freepages -= release_freepages(&cc->freepages);
 	VM_BUG_ON(cc->nr_freepages != 0);
 
+	if (cc->bounded) {
+		if (ret == COMPACT_COMPLETE) {
+			zone->compact_cached_migrate_pfn = 0;
+			zone->compact_cached_free_pfn = 0;
+		} else {
+			zone->compact_cached_migrate_pfn = cc->migrate_pfn;
+			zone->compact_cached_free_pfn = cc->free_pfn;
+		}
+	}
+
 	return ret;
 }
 
@@ -758,6 +791,170 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd compacts the zones of a node in the background, so that
+ * high-order allocations that cannot compact themselves, atomic ones in
+ * particular, still find free blocks.  It is woken by kswapd once reclaim
+ * is done and by high-order allocations entering the slow path, and only
+ * works on zones where compaction_suitable() blames fragmentation.  Each
+ * run is limited to sysctl_kcompactd_budget isolation rounds per zone.
+ */
+int sysctl_kcompactd_order = 3;
+int sysctl_kcompactd_budget = 64;
+
+/* Back-off after running out of budget with work left */
+#define KCOMPACTD_BACKOFF	(HZ / 10)
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order)
+{
+	int zoneid;
+	struct zone *zone;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+		if (compaction_suitable(zone, order) == COMPACT_CONTINUE)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * wakeup_kcompactd - kick background compaction of a node
+ * @pgdat: node that ran short of high-order blocks
+ * @order: order that is needed, at least sysctl_kcompactd_order is kept
+ *
+ * Does nothing unless a zone of the node needs compaction.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	if (!sysctl_kcompactd_order || !pgdat->kcompactd)
+		return;
+
+	order = max(order, sysctl_kcompactd_order);
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	if (!kcompactd_node_suitable(pgdat, order))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	count_vm_event(COMPACTDWAKE);
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * Returns true if the budget ran out on a zone that still needs
+ * compaction, the work is then requeued.
+ */
+static bool kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = pgdat->kcompactd_max_order;
+	bool requeue = false;
+	int zoneid, status;
+	struct zone *zone;
+
+	pgdat->kcompactd_max_order = 0;
+	lru_add_drain();
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		/*
+		 * Allocations that cannot compact themselves are mostly
+		 * unmovable kernel ones, so look for blocks of that type.
+		 */
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_UNMOVABLE,
+			.sync = false,
+			.bounded = true,
+			.budget = sysctl_kcompactd_budget,
+		};
+
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+		if (compaction_deferred(zone))
+			continue;
+		if (compaction_suitable(zone, order) != COMPACT_CONTINUE)
+			continue;
+
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		status = compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone),
+				      0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			count_vm_event(COMPACTDSUCCESS);
+		} else if (status == COMPACT_COMPLETE) {
+			/* The whole zone was scanned in vain */
+			defer_compaction(zone);
+			count_vm_event(COMPACTDFAIL);
+		} else if (!cc.budget) {
+			count_vm_event(COMPACTDBUDGET);
+			requeue = true;
+		}
+
+		if (kthread_should_stop())
+			return false;
+	}
+
+	if (requeue && pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	return requeue;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				     pgdat->kcompactd_max_order ||
+				     kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		if (kcompactd_do_work(pgdat))
+			schedule_timeout_interruptible(KCOMPACTD_BACKOFF);
+	}
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		task = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+		if (IS_ERR(task)) {
+			pr_err("Failed to start kcompactd on node %d\n", nid);
+			continue;
+		}
+		pgdat->kcompactd = task;
+	}
+	return 0;
+}
+module_init(kcompactd_init);
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
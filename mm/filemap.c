@@ -35,6 +35,7 @@
 #include <linux/memcontrol.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
 #include <linux/cleancache.h>
+#include <linux/pagecache_prefetch.h>
 #include "internal.h"
 
 /*
@@ -1276,6 +1277,7 @@ no_cached_page:
 			desc->error = error;
 			goto out;
 		}
+		prefetch_record(filp, index);
 		goto readpage;
 	}
 
@@ -1529,10 +1531,12 @@ static int page_cache_read(struct file *file, pgoff_t offset)
 			return -ENOMEM;
 
 		ret = add_to_page_cache_lru(page, mapping, offset, GFP_KERNEL);
-		if (ret == 0)
+		if (ret == 0) {
+			prefetch_record(file, offset);
 			ret = mapping->a_ops->readpage(file, page);
-		else if (ret == -EEXIST)
+		} else if (ret == -EEXIST) {
 			ret = 0; /* losing race to add is OK */
+		}
 
 		page_cache_release(page);
 
@@ -0,0 +1,763 @@
+/*
+ * mm/pagecache_prefetch.c
+ *
+ * Page cache prefetch recorder and replayer.
+ *
+ * While a recording window is open (from boot, or from "start" written to
+ * the record file until "stop"), every page cache page that has to be read
+ * in from the backing store is logged per file.  Reading the record file
+ * afterwards gives the trace, one "<index> <nr_pages> <path>" line per
+ * extent, files in the order of their first miss and extents sorted.
+ *
+ * Writing such a trace back to the replay file, ideally right before the
+ * same window, reads each extent in with force_page_cache_readahead(), so
+ * that the scattered small reads of the window become a few large ones.
+ * The stats file tells how many of the prefetched pages got used.  The
+ * replayed extents are remembered by device and inode number only, so
+ * they pin nothing; a page is settled once it is seen used or gone, and
+ * whatever is still unused replay_settle_secs after the replay is
+ * counted as such and forgotten.
+ */
+
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <linux/pagecache_prefetch.h>
+
+#define PREFETCH_HASH_BITS	8
+#define PREFETCH_MAX_EXTENTS	65536
+/* Holes up to this many pages are read along to get larger batches */
+#define PREFETCH_HOLE_PAGES	4
+#define PREFETCH_LINE_MAX	(PATH_MAX + 48)
+
+struct prefetch_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+/* A recorded file */
+struct prefetch_file {
+	struct hlist_node hash;
+	struct list_head list;
+	dev_t dev;
+	unsigned long ino;
+	char *path;
+	unsigned int nr_extents;
+	unsigned int max_extents;
+	struct prefetch_extent *extents;
+};
+
+/* A replayed extent, remembers the pages it brought in that are unsettled */
+struct prefetch_replay {
+	struct list_head list;
+	dev_t dev;
+	unsigned long ino;
+	u32 generation;
+	pgoff_t start;
+	unsigned long nr;
+	unsigned long pending[0];
+};
+
+/* Per open state of the replay file */
+struct prefetch_replay_ctx {
+	struct file *filp;
+	size_t len;
+	char path[PATH_MAX];
+	char buf[PREFETCH_LINE_MAX];
+};
+
+static struct prefetch_stats {
+	unsigned long files;
+	unsigned long extents;
+	unsigned long pages;
+	unsigned long dropped;
+	unsigned long replay_files;
+	unsigned long replay_failed;
+	unsigned long replay_extents;
+	unsigned long replay_requested;
+	unsigned long replay_prefetched;
+	unsigned long replay_used;
+	unsigned long replay_unused;
+	unsigned long replay_evicted;
+} prefetch_stats;
+
+int prefetch_recording __read_mostly;
+static pid_t prefetch_tgid;
+static unsigned int prefetch_nr_extents;
+static struct task_struct *prefetch_replayer;
+
+/* prefetch_lock protects the trace while recording, prefetch_mutex the rest */
+static DEFINE_SPINLOCK(prefetch_lock);
+static DEFINE_MUTEX(prefetch_mutex);
+static struct hlist_head prefetch_hash[1 << PREFETCH_HASH_BITS];
+static LIST_HEAD(prefetch_files);
+static LIST_HEAD(prefetch_replays);
+
+static bool record_boot;
+module_param(record_boot, bool, S_IRUGO);
+static unsigned int replay_settle_secs = 120;
+module_param(replay_settle_secs, uint, S_IRUGO | S_IWUSR);
+
+static struct hlist_head *prefetch_hash_head(dev_t dev, unsigned long ino)
+{
+	return &prefetch_hash[hash_long(ino ^ dev, PREFETCH_HASH_BITS)];
+}
+
+static struct prefetch_file *prefetch_lookup(struct inode *inode)
+{
+	struct prefetch_file *pf;
+	struct hlist_node *node;
+	dev_t dev = inode->i_sb->s_dev;
+
+	hlist_for_each_entry(pf, node, prefetch_hash_head(dev, inode->i_ino),
+			     hash)
+		if (pf->dev == dev && pf->ino == inode->i_ino)
+			return pf;
+	return NULL;
+}
+
+static void prefetch_file_free(struct prefetch_file *pf)
+{
+	kfree(pf->extents);
+	kfree(pf->path);
+	kfree(pf);
+}
+
+static struct prefetch_file *prefetch_file_alloc(struct file *filp,
+						 struct inode *inode)
+{
+	struct prefetch_file *pf;
+	char *buf, *path;
+
+	pf = kzalloc(sizeof(*pf), GFP_NOFS);
+	buf = kmalloc(PATH_MAX, GFP_NOFS);
+	if (!pf || !buf)
+		goto fail;
+
+	path = d_path(&filp->f_path, buf, PATH_MAX);
+	if (IS_ERR(path))
+		goto fail;
+	pf->path = kstrdup(path, GFP_NOFS);
+	if (!pf->path)
+		goto fail;
+	kfree(buf);
+
+	pf->dev = inode->i_sb->s_dev;
+	pf->ino = inode->i_ino;
+	return pf;
+
+fail:
+	kfree(buf);
+	kfree(pf);
+	return NULL;
+}
+
+/* Reads in are mostly ascending, so only try to extend the last extent */
+static void prefetch_add_page(struct prefetch_file *pf, pgoff_t index)
+{
+	struct prefetch_extent *ext;
+	unsigned int size;
+
+	if (pf->nr_extents) {
+		ext = &pf->extents[pf->nr_extents - 1];
+		if (index >= ext->start && index < ext->start + ext->nr)
+			return;
+		if (index == ext->start + ext->nr) {
+			ext->nr++;
+			prefetch_stats.pages++;
+			return;
+		}
+	}
+
+	if (prefetch_nr_extents >= PREFETCH_MAX_EXTENTS)
+		goto drop;
+
+	if (pf->nr_extents == pf->max_extents) {
+		size = pf->max_extents ? pf->max_extents * 2 : 8;
+		ext = krealloc(pf->extents, size * sizeof(*ext),
+			       GFP_ATOMIC | __GFP_NOWARN);
+		if (!ext)
+			goto drop;
+		pf->extents = ext;
+		pf->max_extents = size;
+	}
+
+	ext = &pf->extents[pf->nr_extents++];
+	ext->start = index;
+	ext->nr = 1;
+	prefetch_nr_extents++;
+	prefetch_stats.extents++;
+	prefetch_stats.pages++;
+	return;
+
+drop:
+	prefetch_stats.dropped++;
+}
+
+void __prefetch_record(struct file *filp, pgoff_t index)
+{
+	struct inode *inode = filp->f_mapping->host;
+	struct prefetch_file *pf, *new = NULL;
+
+	if (!S_ISREG(inode->i_mode) || current == prefetch_replayer)
+		return;
+	if (prefetch_tgid && task_tgid_nr(current) != prefetch_tgid)
+		return;
+
+	spin_lock(&prefetch_lock);
+	pf = prefetch_lookup(inode);
+	if (!pf && prefetch_recording) {
+		spin_unlock(&prefetch_lock);
+		new = prefetch_file_alloc(filp, inode);
+		spin_lock(&prefetch_lock);
+		pf = prefetch_lookup(inode);
+		if (!pf && new && prefetch_recording) {
+			pf = new;
+			new = NULL;
+			hlist_add_head(&pf->hash,
+				       prefetch_hash_head(pf->dev, pf->ino));
+			list_add_tail(&pf->list, &prefetch_files);
+			prefetch_stats.files++;
+		}
+	}
+	if (prefetch_recording) {
+		if (pf)
+			prefetch_add_page(pf, index);
+		else
+			prefetch_stats.dropped++;
+	}
+	spin_unlock(&prefetch_lock);
+
+	if (new)
+		prefetch_file_free(new);
+}
+
+static int prefetch_extent_cmp(const void *a, const void *b)
+{
+	const struct prefetch_extent *x = a, *y = b;
+
+	if (x->start < y->start)
+		return -1;
+	return x->start > y->start;
+}
+
+/* Sort the extents of a file and merge the overlapping or close ones */
+static void prefetch_file_sort(struct prefetch_file *pf)
+{
+	struct prefetch_extent *ext = pf->extents;
+	unsigned int i, j;
+	pgoff_t end;
+
+	if (!pf->nr_extents)
+		return;
+
+	sort(ext, pf->nr_extents, sizeof(*ext), prefetch_extent_cmp, NULL);
+	for (i = 1, j = 0; i < pf->nr_extents; i++) {
+		end = ext[j].start + ext[j].nr;
+		if (ext[i].start <= end + PREFETCH_HOLE_PAGES) {
+			end = max(end, ext[i].start + ext[i].nr);
+			ext[j].nr = end - ext[j].start;
+		} else {
+			ext[++j] = ext[i];
+		}
+	}
+	pf->nr_extents = j + 1;
+}
+
+/* Called with prefetch_mutex held */
+static void prefetch_record_stop(void)
+{
+	struct prefetch_file *pf;
+
+	spin_lock(&prefetch_lock);
+	prefetch_recording = 0;
+	spin_unlock(&prefetch_lock);
+
+	list_for_each_entry(pf, &prefetch_files, list)
+		prefetch_file_sort(pf);
+}
+
+/* Called with prefetch_mutex held and recording stopped */
+static void prefetch_record_clear(void)
+{
+	struct prefetch_file *pf, *next;
+	LIST_HEAD(files);
+	int i;
+
+	/* Late recorders may still look the hash up */
+	spin_lock(&prefetch_lock);
+	list_splice_init(&prefetch_files, &files);
+	for (i = 0; i < ARRAY_SIZE(prefetch_hash); i++)
+		INIT_HLIST_HEAD(&prefetch_hash[i]);
+	prefetch_nr_extents = 0;
+	prefetch_stats.files = 0;
+	prefetch_stats.extents = 0;
+	prefetch_stats.pages = 0;
+	prefetch_stats.dropped = 0;
+	spin_unlock(&prefetch_lock);
+
+	list_for_each_entry_safe(pf, next, &files, list)
+		prefetch_file_free(pf);
+}
+
+static void prefetch_record_start(pid_t tgid)
+{
+	prefetch_record_stop();
+	prefetch_record_clear();
+
+	spin_lock(&prefetch_lock);
+	prefetch_tgid = tgid;
+	prefetch_recording = 1;
+	spin_unlock(&prefetch_lock);
+}
+
+static void *prefetch_record_seq_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&prefetch_mutex);
+	return seq_list_start(&prefetch_files, *pos);
+}
+
+static void *prefetch_record_seq_next(struct seq_file *m, void *v,
+				      loff_t *pos)
+{
+	return seq_list_next(v, &prefetch_files, pos);
+}
+
+static void prefetch_record_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&prefetch_mutex);
+}
+
+static int prefetch_record_seq_show(struct seq_file *m, void *v)
+{
+	struct prefetch_file *pf = list_entry(v, struct prefetch_file, list);
+	unsigned int i;
+
+	for (i = 0; i < pf->nr_extents; i++)
+		seq_printf(m, "%lu %lu %s\n", pf->extents[i].start,
+			   pf->extents[i].nr, pf->path);
+	return 0;
+}
+
+static const struct seq_operations prefetch_record_seq_ops = {
+	.start = prefetch_record_seq_start,
+	.next = prefetch_record_seq_next,
+	.stop = prefetch_record_seq_stop,
+	.show = prefetch_record_seq_show,
+};
+
+static int prefetch_record_open(struct inode *inode, struct file *file)
+{
+	if (!(file->f_mode & FMODE_READ))
+		return 0;
+	/* The trace is only stable once the window is closed */
+	if (prefetch_recording)
+		return -EBUSY;
+	return seq_open(file, &prefetch_record_seq_ops);
+}
+
+static int prefetch_record_release(struct inode *inode, struct file *file)
+{
+	if (!(file->f_mode & FMODE_READ))
+		return 0;
+	return seq_release(inode, file);
+}
+
+static ssize_t prefetch_record_write(struct file *file,
+				     const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	char buf[32];
+	size_t len = min(count, sizeof(buf) - 1);
+	unsigned long tgid = 0;
+
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+	strim(buf);
+
+	mutex_lock(&prefetch_mutex);
+	if (!strncmp(buf, "start", 5) &&
+	    (buf[5] == '\0' || !strict_strtoul(skip_spaces(buf + 5), 10, &tgid)))
+		prefetch_record_start(tgid);
+	else if (!strcmp(buf, "stop"))
+		prefetch_record_stop();
+	else if (!strcmp(buf, "clear")) {
+		prefetch_record_stop();
+		prefetch_record_clear();
+	} else
+		count = -EINVAL;
+	mutex_unlock(&prefetch_mutex);
+
+	return count;
+}
+
+static const struct file_operations prefetch_record_fops = {
+	.open = prefetch_record_open,
+	.read = seq_read,
+	.write = prefetch_record_write,
+	.llseek = seq_lseek,
+	.release = prefetch_record_release,
+};
+
+/* Called with prefetch_mutex held */
+static int prefetch_replay_extent(struct file *filp, pgoff_t start,
+				  unsigned long nr)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct inode *inode = mapping->host;
+	loff_t isize = i_size_read(inode);
+	struct prefetch_replay *re;
+	struct page *page;
+	pgoff_t end;
+	unsigned long i;
+
+	if (!isize)
+		return 0;
+	end = (isize - 1) >> PAGE_CACHE_SHIFT;
+	if (!nr || start > end)
+		return 0;
+	nr = min(nr, end - start + 1);
+
+	re = kzalloc(sizeof(*re) + BITS_TO_LONGS(nr) * sizeof(long),
+		     GFP_KERNEL);
+	if (!re)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		page = find_get_page(mapping, start + i);
+		if (page)
+			page_cache_release(page);
+		else
+			__set_bit(i, re->pending);
+	}
+
+	force_page_cache_readahead(mapping, filp, start, nr);
+
+	re->dev = inode->i_sb->s_dev;
+	re->ino = inode->i_ino;
+	re->generation = inode->i_generation;
+	re->start = start;
+	re->nr = nr;
+	list_add_tail(&re->list, &prefetch_replays);
+
+	prefetch_stats.replay_extents++;
+	prefetch_stats.replay_requested += nr;
+	prefetch_stats.replay_prefetched += bitmap_weight(re->pending, nr);
+	return 0;
+}
+
+/*
+ * Replay one "<index> <nr_pages> <path>" line.  Lines of the same file
+ * follow each other in a trace, so keep the last file open.
+ */
+static int prefetch_replay_line(struct prefetch_replay_ctx *ctx, char *line)
+{
+	unsigned long start, nr;
+	struct file *filp;
+	char *path;
+	int n = 0;
+
+	line = strim(line);
+	if (!*line)
+		return 0;
+	if (sscanf(line, "%lu %lu %n", &start, &nr, &n) != 2 || !n ||
+	    line[n] != '/')
+		return -EINVAL;
+	path = line + n;
+
+	if (strcmp(ctx->path, path)) {
+		if (ctx->filp && !IS_ERR(ctx->filp))
+			fput(ctx->filp);
+		strlcpy(ctx->path, path, sizeof(ctx->path));
+		filp = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+		ctx->filp = filp;
+		if (IS_ERR(filp))
+			prefetch_stats.replay_failed++;
+		else
+			prefetch_stats.replay_files++;
+	}
+	if (IS_ERR(ctx->filp))
+		return 0;
+
+	return prefetch_replay_extent(ctx->filp, start, nr);
+}
+
+/*
+ * A prefetched page counts as used once it has been referenced or
+ * mapped.  Prefetched pages that are gone by now are counted apart,
+ * they may have been used before being reclaimed.  The inode is only
+ * looked up if it is still in core, a file that is not has no pages.
+ */
+static void prefetch_replay_settle_one(struct prefetch_replay *re,
+				       bool final)
+{
+	struct super_block *sb;
+	struct inode *inode = NULL;
+	struct page *page;
+	unsigned long i;
+
+	sb = user_get_super(re->dev);
+	if (sb) {
+		inode = ilookup(sb, re->ino);
+		if (inode && inode->i_generation != re->generation) {
+			iput(inode);
+			inode = NULL;
+		}
+	}
+
+	for_each_set_bit(i, re->pending, re->nr) {
+		page = NULL;
+		if (inode)
+			page = find_get_page(inode->i_mapping, re->start + i);
+		if (!page) {
+			prefetch_stats.replay_evicted++;
+		} else if (PageReferenced(page) || PageActive(page) ||
+			   page_mapped(page)) {
+			prefetch_stats.replay_used++;
+		} else if (final) {
+			prefetch_stats.replay_unused++;
+		} else {
+			page_cache_release(page);
+			continue;
+		}
+		if (page)
+			page_cache_release(page);
+		__clear_bit(i, re->pending);
+	}
+
+	if (inode)
+		iput(inode);
+	if (sb)
+		drop_super(sb);
+}
+
+/*
+ * Called with prefetch_mutex held.  Settles what can be settled and
+ * forgets the extents with nothing left pending, or all of them if final.
+ */
+static void prefetch_replay_settle(bool final)
+{
+	struct prefetch_replay *re, *next;
+
+	list_for_each_entry_safe(re, next, &prefetch_replays, list) {
+		prefetch_replay_settle_one(re, final);
+		if (bitmap_empty(re->pending, re->nr)) {
+			list_del(&re->list);
+			kfree(re);
+		}
+	}
+}
+
+static void prefetch_settle_workfn(struct work_struct *work)
+{
+	mutex_lock(&prefetch_mutex);
+	prefetch_replay_settle(true);
+	mutex_unlock(&prefetch_mutex);
+}
+static DECLARE_DELAYED_WORK(prefetch_settle_work, prefetch_settle_workfn);
+
+/* Restart the settle timeout, the replay has just been fed */
+static void prefetch_replay_settle_later(void)
+{
+	cancel_delayed_work(&prefetch_settle_work);
+	schedule_delayed_work(&prefetch_settle_work,
+			      replay_settle_secs * HZ);
+}
+
+/* Called with prefetch_mutex held */
+static void prefetch_replay_clear(void)
+{
+	struct prefetch_replay *re, *next;
+
+	list_for_each_entry_safe(re, next, &prefetch_replays, list) {
+		list_del(&re->list);
+		kfree(re);
+	}
+	prefetch_stats.replay_files = 0;
+	prefetch_stats.replay_failed = 0;
+	prefetch_stats.replay_extents = 0;
+	prefetch_stats.replay_requested = 0;
+	prefetch_stats.replay_prefetched = 0;
+	prefetch_stats.replay_used = 0;
+	prefetch_stats.replay_unused = 0;
+	prefetch_stats.replay_evicted = 0;
+}
+
+static int prefetch_replay_open(struct inode *inode, struct file *file)
+{
+	struct prefetch_replay_ctx *ctx;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	file->private_data = ctx;
+	return 0;
+}
+
+static ssize_t prefetch_replay_write(struct file *file,
+				     const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct prefetch_replay_ctx *ctx = file->private_data;
+	size_t done = 0, len;
+	char *nl;
+	int ret = 0;
+
+	mutex_lock(&prefetch_mutex);
+	prefetch_replayer = current;
+	while (done < count) {
+		len = min(count - done, sizeof(ctx->buf) - 1 - ctx->len);
+		if (!len) {
+			/* Line too long */
+			ctx->len = 0;
+			ret = -EINVAL;
+			break;
+		}
+		if (copy_from_user(ctx->buf + ctx->len, ubuf + done, len)) {
+			ret = -EFAULT;
+			break;
+		}
+		ctx->len += len;
+		ctx->buf[ctx->len] = '\0';
+		done += len;
+
+		while ((nl = strchr(ctx->buf, '\n'))) {
+			*nl = '\0';
+			ret = prefetch_replay_line(ctx, ctx->buf);
+			ctx->len -= nl + 1 - ctx->buf;
+			memmove(ctx->buf, nl + 1, ctx->len + 1);
+			if (ret)
+				goto out;
+		}
+	}
+out:
+	prefetch_replayer = NULL;
+	prefetch_replay_settle_later();
+	mutex_unlock(&prefetch_mutex);
+
+	return ret ? ret : count;
+}
+
+static int prefetch_replay_release(struct inode *inode, struct file *file)
+{
+	struct prefetch_replay_ctx *ctx = file->private_data;
+
+	mutex_lock(&prefetch_mutex);
+	prefetch_replayer = current;
+	if (ctx->len)
+		prefetch_replay_line(ctx, ctx->buf);
+	prefetch_replayer = NULL;
+	prefetch_replay_settle_later();
+	mutex_unlock(&prefetch_mutex);
+
+	if (ctx->filp && !IS_ERR(ctx->filp))
+		fput(ctx->filp);
+	kfree(ctx);
+	return 0;
+}
+
+static const struct file_operations prefetch_replay_fops = {
+	.open = prefetch_replay_open,
+	.write = prefetch_replay_write,
+	.release = prefetch_replay_release,
+};
+
+static int prefetch_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned long unused_pages;
+	struct prefetch_replay *re;
+
+	mutex_lock(&prefetch_mutex);
+	prefetch_replay_settle(false);
+	/* What is still pending is in core and unused so far */
+	unused_pages = prefetch_stats.replay_unused;
+	list_for_each_entry(re, &prefetch_replays, list)
+		unused_pages += bitmap_weight(re->pending, re->nr);
+
+	seq_printf(m, "recording %d\n", prefetch_recording);
+	seq_printf(m, "recording_tgid %d\n", prefetch_tgid);
+	seq_printf(m, "recorded_files %lu\n", prefetch_stats.files);
+	seq_printf(m, "recorded_extents %lu\n", prefetch_stats.extents);
+	seq_printf(m, "recorded_pages %lu\n", prefetch_stats.pages);
+	seq_printf(m, "recorded_dropped %lu\n", prefetch_stats.dropped);
+	seq_printf(m, "replay_files %lu\n", prefetch_stats.replay_files);
+	seq_printf(m, "replay_open_failed %lu\n",
+		   prefetch_stats.replay_failed);
+	seq_printf(m, "replay_extents %lu\n", prefetch_stats.replay_extents);
+	seq_printf(m, "replay_requested %lu\n",
+		   prefetch_stats.replay_requested);
+	seq_printf(m, "replay_prefetched %lu\n",
+		   prefetch_stats.replay_prefetched);
+	seq_printf(m, "prefetched_used %lu\n", prefetch_stats.replay_used);
+	seq_printf(m, "prefetched_unused %lu\n", unused_pages);
+	seq_printf(m, "prefetched_evicted %lu\n",
+		   prefetch_stats.replay_evicted);
+	mutex_unlock(&prefetch_mutex);
+
+	return 0;
+}
+
+static int prefetch_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, prefetch_stats_show, NULL);
+}
+
+/* Writing "clear" drops the replayed extents along with their stats */
+static ssize_t prefetch_stats_write(struct file *file,
+				    const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	char buf[8];
+	size_t len = min(count, sizeof(buf) - 1);
+
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+	if (strcmp(strim(buf), "clear"))
+		return -EINVAL;
+
+	mutex_lock(&prefetch_mutex);
+	prefetch_replay_clear();
+	mutex_unlock(&prefetch_mutex);
+
+	return count;
+}
+
+static const struct file_operations prefetch_stats_fops = {
+	.open = prefetch_stats_open,
+	.read = seq_read,
+	.write = prefetch_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init pagecache_prefetch_init(void)
+{
+	struct dentry *dir;
+
+	if (record_boot)
+		prefetch_recording = 1;
+
+	dir = debugfs_create_dir("pagecache_prefetch", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENOMEM;
+	debugfs_create_file("record", S_IRUSR | S_IWUSR, dir, NULL,
+			    &prefetch_record_fops);
+	debugfs_create_file("replay", S_IWUSR, dir, NULL,
+			    &prefetch_replay_fops);
+	debugfs_create_file("stats", S_IRUSR | S_IWUSR, dir, NULL,
+			    &prefetch_stats_fops);
+	return 0;
+}
+module_init(pagecache_prefetch_init);
@@ -17,6 +17,7 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/pagecache_prefetch.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -190,6 +191,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		list_add(&page->lru, &page_pool);
 		if (page_idx == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
+		prefetch_record(filp, page_offset);
 		ret++;
 	}
 
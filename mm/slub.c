@@ -1422,10 +1422,15 @@ static inline int lock_and_freeze_slab(struct kmem_cache_node *n,
 
 /*
  * Try to allocate a partial slab from a specific node.
+ *
+ * If @c is given, also move up to half of the free room of its cpu
+ * partial list over while holding the list_lock anyway.
  */
-static struct page *get_partial_node(struct kmem_cache_node *n)
+static struct page *get_partial_node(struct kmem_cache *s,
+		struct kmem_cache_node *n, struct kmem_cache_cpu *c)
 {
-	struct page *page;
+	struct page *page, *next, *found = NULL;
+	unsigned int extra = 0;
 
 	/*
 	 * Racy check. If we mistakenly see no partial slabs then we
@@ -1436,14 +1441,27 @@ static struct page *get_partial_node(struct kmem_cache_node *n)
 	if (!n || !n->nr_partial)
 		return NULL;
 
+	if (c && s->cpu_partial > c->nr_partial)
+		extra = (s->cpu_partial - c->nr_partial) / 2;
+
 	spin_lock(&n->list_lock);
-	list_for_each_entry(page, &n->partial, lru)
-		if (lock_and_freeze_slab(n, page))
-			goto out;
-	page = NULL;
-out:
+	list_for_each_entry_safe(page, next, &n->partial, lru) {
+		if (!lock_and_freeze_slab(n, page))
+			continue;
+		if (!found) {
+			found = page;
+		} else {
+			slab_unlock(page);
+			list_add_tail(&page->lru, &c->partial);
+			c->nr_partial++;
+			stat(s, CPU_PARTIAL_NODE);
+			extra--;
+		}
+		if (!extra || n->nr_partial <= s->min_partial)
+			break;
+	}
 	spin_unlock(&n->list_lock);
-	return page;
+	return found;
 }
 
 /*
@@ -1491,7 +1509,7 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 
 			if (n && cpuset_zone_allowed_hardwall(zone, flags) &&
 					n->nr_partial > s->min_partial) {
-				page = get_partial_node(n);
+				page = get_partial_node(s, n, NULL);
 				if (page) {
 					/*
 					 * Return the object even if
@@ -1514,12 +1532,16 @@ static struct page *get_any_partial(struct kmem_cache *s, gfp_t flags)
 /*
  * Get a partial page, lock it and return it.
  */
-static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node)
+static struct page *get_partial(struct kmem_cache *s, gfp_t flags, int node,
+				struct kmem_cache_cpu *c)
 {
 	struct page *page;
 	int searchnode = (node == NUMA_NO_NODE) ? numa_node_id() : node;
 
-	page = get_partial_node(get_node(s, searchnode));
+	/* The cpu partial list only holds slabs of the local node */
+	if (searchnode != numa_node_id())
+		c = NULL;
+	page = get_partial_node(s, get_node(s, searchnode), c);
 	if (page || node != NUMA_NO_NODE)
 		return page;
 
@@ -1636,8 +1658,12 @@ void init_kmem_cache_cpus(struct kmem_cache *s)
 {
 	int cpu;
 
-	for_each_possible_cpu(cpu)
-		per_cpu_ptr(s->cpu_slab, cpu)->tid = init_tid(cpu);
+	for_each_possible_cpu(cpu) {
+		struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
+
+		c->tid = init_tid(cpu);
+		INIT_LIST_HEAD(&c->partial);
+	}
 }
 /*
  * Remove the cpu slab
@@ -1681,6 +1707,44 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	deactivate_slab(s, c);
 }
 
+/*
+ * Move the slabs of a cpu partial list back to the node partial lists.
+ *
+ * Called with interrupts disabled.
+ */
+static void unfreeze_partials(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, &c->partial, lru) {
+		list_del(&page->lru);
+		slab_lock(page);
+		unfreeze_slab(s, page, 1);
+	}
+	c->nr_partial = 0;
+}
+
+/*
+ * Put a slab that got its first free object back onto the cpu partial
+ * list, so that neither this free nor the next allocation from the slab
+ * has to take the node list_lock.  A full cpu partial list is drained
+ * first.
+ *
+ * Called with interrupts disabled and the slab frozen.
+ */
+static void put_cpu_partial(struct kmem_cache *s, struct page *page)
+{
+	struct kmem_cache_cpu *c = __this_cpu_ptr(s->cpu_slab);
+
+	if (c->nr_partial >= s->cpu_partial) {
+		unfreeze_partials(s, c);
+		stat(s, CPU_PARTIAL_DRAIN);
+	}
+	list_add(&page->lru, &c->partial);
+	c->nr_partial++;
+	stat(s, CPU_PARTIAL_FREE);
+}
+
 /*
  * Flush cpu slab.
  *
@@ -1690,8 +1754,12 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	if (likely(c && c->page))
+	if (unlikely(!c))
+		return;
+	if (c->page)
 		flush_slab(s, c);
+	if (c->nr_partial)
+		unfreeze_partials(s, c);
 }
 
 static void flush_cpu_slab(void *d)
@@ -1857,7 +1925,18 @@ another_slab:
 	deactivate_slab(s, c);
 
 new_slab:
-	page = get_partial(s, gfpflags, node);
+	if (c->nr_partial && (node == NUMA_NO_NODE || node == numa_node_id())) {
+		page = list_first_entry(&c->partial, struct page, lru);
+		list_del(&page->lru);
+		c->nr_partial--;
+		stat(s, CPU_PARTIAL_ALLOC);
+		slab_lock(page);
+		c->node = page_to_nid(page);
+		c->page = page;
+		goto load_freelist;
+	}
+
+	page = get_partial(s, gfpflags, node, c);
 	if (page) {
 		stat(s, ALLOC_FROM_PARTIAL);
 		c->node = page_to_nid(page);
@@ -2071,9 +2150,17 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 	/*
 	 * Objects left in the slab. If it was not on the partial list before
-	 * then add it.
+	 * then add it, to the cpu partial list if possible.
 	 */
 	if (unlikely(!prior)) {
+		if (s->cpu_partial && !kmem_cache_debug(s) &&
+		    page_to_nid(page) == numa_node_id()) {
+			__SetPageSlubFrozen(page);
+			slab_unlock(page);
+			put_cpu_partial(s, page);
+			local_irq_restore(flags);
+			return;
+		}
 		add_partial(get_node(s, page_to_nid(page)), page, 1);
 		stat(s, FREE_ADD_PARTIAL);
 	}
@@ -2610,6 +2697,24 @@ static int kmem_cache_open(struct kmem_cache *s,
 	 * list to avoid pounding the page allocator excessively.
 	 */
 	set_min_partial(s, ilog2(s->size));
+
+	/*
+	 * Per cpu partial slabs save node list_lock round trips on the
+	 * alloc and free slow paths, at the cost of keeping a few more
+	 * partially free slabs around.  Keep fewer of the larger slabs.
+	 * Debugging needs all slabs on the node lists.
+	 */
+	if (kmem_cache_debug(s))
+		s->cpu_partial = 0;
+	else if (s->size >= PAGE_SIZE)
+		s->cpu_partial = 2;
+	else if (s->size >= 1024)
+		s->cpu_partial = 4;
+	else if (s->size >= 256)
+		s->cpu_partial = 6;
+	else
+		s->cpu_partial = 8;
+
 	s->refcount = 1;
 #ifdef CONFIG_NUMA
 	s->remote_node_defrag_ratio = 1000;
@@ -4157,6 +4262,51 @@ static ssize_t min_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(min_partial);
 
+static ssize_t cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	return sprintf(buf, "%u\n", s->cpu_partial);
+}
+
+static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
+				 size_t length)
+{
+	unsigned long slabs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &slabs);
+	if (err)
+		return err;
+	if (slabs && kmem_cache_debug(s))
+		return -EINVAL;
+
+	s->cpu_partial = slabs;
+	/* Lists above the new limit shrink on their next drain */
+	if (!slabs)
+		flush_all(s);
+	return length;
+}
+SLAB_ATTR(cpu_partial);
+
+static ssize_t slabs_cpu_partial_show(struct kmem_cache *s, char *buf)
+{
+	unsigned long total = 0;
+	int cpu, len = 0;
+
+	for_each_online_cpu(cpu)
+		total += per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+	len = sprintf(buf, "%lu", total);
+#ifdef CONFIG_SMP
+	for_each_online_cpu(cpu) {
+		unsigned int nr = per_cpu_ptr(s->cpu_slab, cpu)->nr_partial;
+
+		if (nr && len < PAGE_SIZE - 20)
+			len += sprintf(buf + len, " C%d=%u", cpu, nr);
+	}
+#endif
+	return len + sprintf(buf + len, "\n");
+}
+SLAB_ATTR_RO(slabs_cpu_partial);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -4503,6 +4653,10 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
+STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
+STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
+STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4511,10 +4665,12 @@ static struct attribute *slab_attrs[] = {
 	&objs_per_slab_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
+	&cpu_partial_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
 	&cpu_slabs_attr.attr,
+	&slabs_cpu_partial_attr.attr,
 	&ctor_attr.attr,
 	&aliases_attr.attr,
 	&align_attr.attr,
@@ -4560,6 +4716,10 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&cpu_partial_alloc_attr.attr,
+	&cpu_partial_free_attr.attr,
+	&cpu_partial_node_attr.attr,
+	&cpu_partial_drain_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -0,0 +1,196 @@
+/*
+ * mm/slub_bench.c
+ *
+ * Cost of kmem_cache_alloc()/kmem_cache_free() with and without the per
+ * cpu partial lists.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * Loading the module runs a thread bound to each online CPU against a
+ * private cache of 64, 256 and 1024 byte objects, once with the default
+ * cpu_partial and once with 0.  Each round every thread allocates a batch
+ * of objects and then frees either its own batch ("local") or the batch
+ * of the thread on the next CPU ("remote"), which is the case that turns
+ * full slabs partial on another CPU.  The time per allocation and per
+ * free is logged.  The load then fails on purpose, so that the module
+ * can be inserted again for another run.
+ */
+
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+
+#define BENCH_BATCH	256
+#define BENCH_ROUNDS	2000
+
+struct bench_thread {
+	struct kmem_cache *cache;
+	void *objs[BENCH_BATCH];
+	struct bench_thread *peer;
+	u64 alloc_ns;
+	u64 free_ns;
+	int err;
+	struct task_struct *task;
+	struct completion done;
+};
+
+static DECLARE_WAIT_QUEUE_HEAD(bench_wq);
+static bool bench_go;
+static bool bench_remote;
+static int bench_nr;
+static atomic_t bench_arrived;
+static int bench_phase;
+
+/* Spin until all bench_nr threads got here, the phases are short */
+static void bench_barrier(void)
+{
+	int phase = ACCESS_ONCE(bench_phase);
+
+	if (atomic_inc_return(&bench_arrived) == bench_nr) {
+		atomic_set(&bench_arrived, 0);
+		smp_mb();
+		ACCESS_ONCE(bench_phase) = phase + 1;
+	} else {
+		while (ACCESS_ONCE(bench_phase) == phase)
+			cpu_relax();
+	}
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	struct bench_thread *victim = bench_remote ? t->peer : t;
+	ktime_t start;
+	int round, i;
+
+	wait_event(bench_wq, bench_go);
+
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		start = ktime_get();
+		for (i = 0; i < BENCH_BATCH; i++)
+			t->objs[i] = kmem_cache_alloc(t->cache, GFP_KERNEL);
+		t->alloc_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (bench_remote)
+			bench_barrier();
+
+		start = ktime_get();
+		for (i = 0; i < BENCH_BATCH; i++) {
+			if (victim->objs[i])
+				kmem_cache_free(t->cache, victim->objs[i]);
+			else
+				t->err = -ENOMEM;
+		}
+		t->free_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (bench_remote)
+			bench_barrier();
+	}
+
+	complete_and_exit(&t->done, 0);
+}
+
+static int bench_run(struct bench_thread *threads, int nr, size_t size,
+		     bool cpu_partial, bool remote)
+{
+	struct kmem_cache *cache;
+	u64 alloc_ns = 0, free_ns = 0, ops;
+	int cpu, i = 0, ret = 0;
+
+	/* SLAB_NOLEAKTRACE keeps it from being merged, its tunables are ours */
+	cache = kmem_cache_create("slub_bench", size, 0, SLAB_NOLEAKTRACE,
+				  NULL);
+	if (!cache)
+		return -ENOMEM;
+	if (!cpu_partial)
+		cache->cpu_partial = 0;
+
+	bench_go = false;
+	bench_remote = remote;
+	atomic_set(&bench_arrived, 0);
+	for_each_online_cpu(cpu) {
+		struct bench_thread *t;
+
+		if (i == nr)
+			break;
+		t = &threads[i];
+		memset(t, 0, sizeof(*t));
+		t->cache = cache;
+		init_completion(&t->done);
+		t->task = kthread_create(bench_thread_fn, t, "slub_bench/%d",
+					 i);
+		if (IS_ERR(t->task)) {
+			ret = PTR_ERR(t->task);
+			while (i--)
+				kthread_stop(threads[i].task);
+			goto out;
+		}
+		kthread_bind(t->task, cpu);
+		i++;
+	}
+	nr = i;
+	bench_nr = nr;
+	for (i = 0; i < nr; i++)
+		threads[i].peer = &threads[(i + 1) % nr];
+
+	for (i = 0; i < nr; i++)
+		wake_up_process(threads[i].task);
+	bench_go = true;
+	smp_mb();
+	wake_up_all(&bench_wq);
+
+	for (i = 0; i < nr; i++) {
+		wait_for_completion(&threads[i].done);
+		alloc_ns += threads[i].alloc_ns;
+		free_ns += threads[i].free_ns;
+		if (threads[i].err)
+			ret = threads[i].err;
+	}
+
+	ops = (u64)BENCH_ROUNDS * BENCH_BATCH * nr;
+	printk(KERN_INFO "slub_bench: %4zu bytes %-6s cpu_partial %-3s "
+	       "%2d threads: alloc %4llu ns, free %4llu ns\n",
+	       size, remote ? "remote" : "local", cpu_partial ? "on" : "off",
+	       nr, div64_u64(alloc_ns, ops), div64_u64(free_ns, ops));
+out:
+	kmem_cache_destroy(cache);
+	return ret;
+}
+
+static int __init slub_bench_init(void)
+{
+	static const size_t sizes[] = { 64, 256, 1024 };
+	struct bench_thread *threads;
+	int nr = num_online_cpus();
+	int ret = -ENOMEM;
+	int i, cpu_partial, remote;
+
+	threads = kcalloc(nr, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return ret;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (remote = 0; remote < (nr > 1 ? 2 : 1); remote++) {
+			for (cpu_partial = 1; cpu_partial >= 0; cpu_partial--) {
+				ret = bench_run(threads, nr, sizes[i],
+						cpu_partial, remote);
+				if (ret)
+					goto out;
+			}
+		}
+	}
+	ret = -EAGAIN;
+out:
+	kfree(threads);
+	return ret;
+}
+module_init(slub_bench_init);
+MODULE_DESCRIPTION("kmem_cache_alloc/kmem_cache_free benchmark");
+MODULE_LICENSE("GPL");
@@ -368,6 +368,30 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+/*
+ * Start reading a swap page ahead of its fault and mark it, so that the
+ * fault finding it in the swap cache can be accounted as a hit.
+ * Returns -ENOMEM if the page could not be read in.
+ */
+static int swap_readahead_page(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+
+	page = find_get_page(&swapper_space, entry.val);
+	if (page) {
+		page_cache_release(page);
+		return 0;
+	}
+	page = read_swap_cache_async(entry, gfp_mask, vma, addr);
+	if (!page)
+		return -ENOMEM;
+	SetPageReadahead(page);
+	count_vm_event(SWAP_RA);
+	page_cache_release(page);
+	return 0;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -404,13 +428,161 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	 */
 	nr_pages = valid_swaphandles(entry, &offset);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
+		if (offset == swp_offset(entry))
+			continue;
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
+		if (swap_readahead_page(swp_entry(swp_type(entry), offset),
+					gfp_mask, vma, addr))
 			break;
-		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * VMA based swap readahead.
+ *
+ * On a compressed swap device (zram) neighbouring swap slots are no
+ * cheaper to read than any others, while the pages that are faulted in
+ * next are usually the virtual neighbours of the faulting address.  So
+ * when vm.swap_vma_readahead is set, read ahead the swap entries found in
+ * the page table around the fault instead of the neighbouring slots.
+ *
+ * vma->swap_readahead_info packs the page aligned address of the last
+ * swap fault, the readahead window used for it and the number of
+ * readahead pages of the vma that got faulted in since.  The window grows
+ * with the hits, up to 1 << page_cluster pages, and shrinks by at most a
+ * half on each fault.
+ */
+int swap_vma_readahead __read_mostly;
+
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN_MAX		(1UL << (SWAP_RA_WIN_SHIFT - 1))
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/**
+ * swap_readahead_hit - account a swap cache hit on a read ahead page
+ * @page: swap cache page found by the fault
+ * @vma: vma of the faulting address
+ *
+ * Called by the swap fault path when it finds the page in the swap cache.
+ */
+void swap_readahead_hit(struct page *page, struct vm_area_struct *vma)
+{
+	unsigned long ra_val;
+
+	if (!TestClearPageReadahead(page))
+		return;
+
+	count_vm_event(SWAP_RA_HIT);
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	if (SWAP_RA_HITS(ra_val) < SWAP_RA_HITS_MAX)
+		atomic_long_cmpxchg(&vma->swap_readahead_info,
+				    ra_val, ra_val + 1);
+}
+
+static unsigned int swap_ra_window(struct vm_area_struct *vma,
+				   unsigned long faddr)
+{
+	unsigned long ra_val, pfn, prev_pfn;
+	unsigned int hits, win, prev_win, max_win;
+
+	max_win = min_t(unsigned long, 1UL << page_cluster, SWAP_RA_WIN_MAX);
+
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	prev_pfn = SWAP_RA_ADDR(ra_val) >> PAGE_SHIFT;
+	prev_win = SWAP_RA_WIN(ra_val);
+	hits = SWAP_RA_HITS(ra_val);
+	pfn = faddr >> PAGE_SHIFT;
+
+	if (hits) {
+		win = roundup_pow_of_two(hits + 2);
+	} else if (pfn == prev_pfn + 1 || pfn + 1 == prev_pfn) {
+		/* No hits yet, but the faults look sequential */
+		win = 2;
+	} else {
+		win = 1;
+	}
+	if (win > max_win)
+		win = max_win;
+	if (win < prev_win / 2)
+		win = prev_win / 2;
+
+	atomic_long_set(&vma->swap_readahead_info,
+			SWAP_RA_VAL(faddr, win, 0));
+	return win;
+}
+
+/**
+ * swapin_vma_readahead - swap in pages around the faulting address
+ * @entry: swap entry of this memory
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma this address belongs to
+ * @addr: faulting address
+ * @pmd: pmd covering @addr
+ *
+ * Returns the struct page for entry and addr, after queueing swapin of
+ * the swap entries mapped in a window around @addr.  The window never
+ * crosses the vma or the page table of @addr.  Falls back to
+ * swapin_readahead() unless vm.swap_vma_readahead is set.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swapin_vma_readahead(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd)
+{
+	pte_t ptes[SWAP_RA_WIN_MAX], *pte;
+	unsigned long faddr = addr & PAGE_MASK;
+	unsigned long start, end, ra_addr;
+	unsigned int win, i, nr;
+	swp_entry_t ra_entry;
+
+	count_vm_event(SWAP_RA_MISS);
+
+	if (!swap_vma_readahead)
+		return swapin_readahead(entry, gfp_mask, vma, addr);
+
+	win = swap_ra_window(vma, faddr);
+	if (win == 1)
+		goto skip;
+
+	start = faddr & ~((unsigned long)win * PAGE_SIZE - 1);
+	end = start + win * PAGE_SIZE;
+	start = max3(start, vma->vm_start, faddr & PMD_MASK);
+	end = pmd_addr_end(faddr, min(end, vma->vm_end));
+	nr = (end - start) >> PAGE_SHIFT;
+
+	/*
+	 * Copy the ptes out: reading the swap cache may sleep.  A stale
+	 * entry only costs a useless read, read_swap_cache_async() checks
+	 * that the slot is still in use.
+	 */
+	pte = pte_offset_map(pmd, start);
+	for (i = 0; i < nr; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0, ra_addr = start; i < nr; i++, ra_addr += PAGE_SIZE) {
+		if (ra_addr == faddr || !is_swap_pte(ptes[i]))
+			continue;
+		ra_entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(ra_entry)))
+			continue;
+		swap_readahead_page(ra_entry, gfp_mask, vma, ra_addr);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+}
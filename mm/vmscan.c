@@ -1346,7 +1346,7 @@ int isolate_lru_page(struct page *page)
 	return ret;
 }
 
-#ifdef CONFIG_ZRAM_FOR_ANDROID
+#if defined(CONFIG_ZRAM_FOR_ANDROID) || defined(CONFIG_PROCESS_RECLAIM)
 /**
  * isolate_lru_page_compcache - tries to isolate a page for compcache
  * @page: page to isolate from its LRU list
@@ -1378,7 +1378,7 @@ int isolate_lru_page_compcache(struct page *page)
 	}
 	return ret;
 }
-#endif
+#endif /* CONFIG_ZRAM_FOR_ANDROID || CONFIG_PROCESS_RECLAIM */
 
 /*
  * Are there way too many processes in the direct reclaim path already?
@@ -1616,7 +1616,7 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 	return nr_reclaimed;
 }
 
-#ifdef CONFIG_ZRAM_FOR_ANDROID
+#if defined(CONFIG_ZRAM_FOR_ANDROID) || defined(CONFIG_PROCESS_RECLAIM)
 unsigned long
 zone_id_shrink_pagelist(struct zone *zone, struct list_head *page_list)
 {
@@ -1647,7 +1647,36 @@ zone_id_shrink_pagelist(struct zone *zone, struct list_head *page_list)
 	return nr_reclaimed;
 }
 EXPORT_SYMBOL(zone_id_shrink_pagelist);
-#endif /* CONFIG_ZRAM_FOR_ANDROID */
+#endif /* CONFIG_ZRAM_FOR_ANDROID || CONFIG_PROCESS_RECLAIM */
+
+#ifdef CONFIG_PROCESS_RECLAIM
+/**
+ * reclaim_pages_from_list - reclaim a list of isolated pages
+ * @page_list: pages isolated with isolate_lru_page_compcache()
+ *
+ * The pages may belong to different zones; they are reclaimed zone by
+ * zone and the ones that cannot be reclaimed are put back on their LRU.
+ * Returns the number of reclaimed pages.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	unsigned long nr_reclaimed = 0;
+
+	while (!list_empty(page_list)) {
+		LIST_HEAD(zone_list);
+		struct page *page, *next;
+		struct zone *zone = page_zone(lru_to_page(page_list));
+
+		list_for_each_entry_safe(page, next, page_list, lru)
+			if (page_zone(page) == zone)
+				list_move(&page->lru, &zone_list);
+
+		nr_reclaimed += zone_id_shrink_pagelist(zone, &zone_list);
+	}
+
+	return nr_reclaimed;
+}
+#endif /* CONFIG_PROCESS_RECLAIM */
 
 /*
  * This moves pages from the active list to the inactive list.
@@ -2928,6 +2957,12 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 	if (!sleeping_prematurely(pgdat, order, remaining, classzone_idx)) {
 		trace_mm_vmscan_kswapd_sleep(pgdat->node_id);
 
+		/*
+		 * Reclaim is done, let kcompactd restore the orders that
+		 * atomic allocations rely on before they are needed.
+		 */
+		wakeup_kcompactd(pgdat, order);
+
 		/*
 		 * vmstat counters are not perfectly accurate and the estimated
 		 * value for counters such as NR_FREE_PAGES can deviate from the
@@ -33,6 +33,8 @@
 #include "util/sort.h"
 #include "util/hist.h"
 
+#include <pthread.h>
+
 static char		const *input_name = "perf.data";
 
 static bool		force, use_tui, use_stdio;
@@ -48,6 +50,279 @@ static const char	*pretty_printing_style = default_pretty_printing_style;
 static char		callchain_default_opt[] = "fractal,0.5";
 static symbol_filter_t	annotate_init;
 
+static int		nr_report_jobs;
+
+/*
+ * With --jobs the main thread still reads, orders and resolves the
+ * samples, as resolving loads dsos lazily and depends on the mmap and
+ * comm events seen so far.  The resolved samples are then handed to
+ * worker threads which do the histogram insertion and callchain
+ * accumulation into private hists, merged back at the end.
+ *
+ * Samples are routed by hist_entry__hash(), so all the samples for a
+ * given hist entry go to the same worker, in order.  Each sample also
+ * carries the comm length at the time it was resolved, for the column
+ * widths, so the result is the same as a serial run.
+ */
+#define REPORT_BATCH_SIZE	(256 * 1024)
+#define REPORT_MAX_QUEUED	16
+
+struct report_chain_entry {
+	u64			ip;
+	struct map		*map;
+	struct symbol		*sym;
+};
+
+struct report_sample {
+	struct perf_evsel	*evsel;
+	struct addr_location	al;
+	struct symbol		*parent;
+	u64			period;
+	int			comm_len;
+	u32			size;
+	u32			nr_chain;
+	struct report_chain_entry chain[0];
+};
+
+struct report_batch {
+	struct list_head	node;
+	size_t			size;
+	u64			data[REPORT_BATCH_SIZE / sizeof(u64)];
+};
+
+struct report_worker {
+	pthread_t		thread;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	struct list_head	queue;
+	int			nr_queued;
+	bool			done;
+	int			err;
+	/* only touched by the main thread */
+	struct report_batch	*fill;
+	/* only touched by the worker until it is joined */
+	struct hists		*hists;
+	int			nr_hists;
+	struct callchain_cursor	cursor;
+};
+
+static struct report_worker	*report_workers;
+static int			nr_report_workers;
+
+static struct hists *report_worker__hists(struct report_worker *self,
+					  struct perf_evsel *evsel)
+{
+	/* attrs can still show up in the middle of a pipe */
+	if (evsel->idx >= self->nr_hists) {
+		int nr = evsel->idx + 1;
+		struct hists *hists = realloc(self->hists, nr * sizeof(*hists));
+
+		if (hists == NULL)
+			return NULL;
+		memset(hists + self->nr_hists, 0,
+		       (nr - self->nr_hists) * sizeof(*hists));
+		self->hists = hists;
+		self->nr_hists = nr;
+	}
+
+	return &self->hists[evsel->idx];
+}
+
+static int report_worker__add_sample(struct report_worker *self,
+				     struct report_sample *sample)
+{
+	struct hists *hists = report_worker__hists(self, sample->evsel);
+	struct hist_entry *he;
+	u32 i;
+
+	if (hists == NULL)
+		return -ENOMEM;
+
+	he = __hists__add_private_entry(hists, &sample->al, sample->parent,
+					sample->period, sample->comm_len);
+	if (he == NULL)
+		return -ENOMEM;
+
+	if (!symbol_conf.use_callchain)
+		return 0;
+
+	callchain_cursor_reset(&self->cursor);
+	for (i = 0; i < sample->nr_chain; i++) {
+		struct report_chain_entry *entry = &sample->chain[i];
+
+		if (callchain_cursor_append(&self->cursor, entry->ip,
+					    entry->map, entry->sym))
+			return -ENOMEM;
+	}
+
+	return callchain_append(he->callchain, &self->cursor, sample->period);
+}
+
+static void *report_worker__thread(void *arg)
+{
+	struct report_worker *self = arg;
+	struct report_batch *batch;
+	size_t pos;
+
+	while (1) {
+		pthread_mutex_lock(&self->lock);
+		while (list_empty(&self->queue) && !self->done)
+			pthread_cond_wait(&self->cond, &self->lock);
+		if (list_empty(&self->queue)) {
+			pthread_mutex_unlock(&self->lock);
+			break;
+		}
+		batch = list_entry(self->queue.next, struct report_batch, node);
+		list_del(&batch->node);
+		self->nr_queued--;
+		pthread_cond_broadcast(&self->cond);
+		pthread_mutex_unlock(&self->lock);
+
+		for (pos = 0; pos < batch->size && !self->err; ) {
+			struct report_sample *sample = (void *)batch->data + pos;
+
+			self->err = report_worker__add_sample(self, sample);
+			pos += sample->size;
+		}
+		free(batch);
+	}
+
+	return NULL;
+}
+
+static void report_worker__push(struct report_worker *self)
+{
+	struct report_batch *batch = self->fill;
+
+	self->fill = NULL;
+	if (batch == NULL)
+		return;
+
+	pthread_mutex_lock(&self->lock);
+	while (self->nr_queued >= REPORT_MAX_QUEUED)
+		pthread_cond_wait(&self->cond, &self->lock);
+	list_add_tail(&batch->node, &self->queue);
+	self->nr_queued++;
+	pthread_cond_broadcast(&self->cond);
+	pthread_mutex_unlock(&self->lock);
+}
+
+static int report_workers__queue(struct addr_location *al,
+				 struct symbol *parent, u64 period,
+				 struct perf_evsel *evsel,
+				 struct callchain_cursor *cursor)
+{
+	struct report_worker *worker;
+	struct report_sample *sample;
+	struct callchain_cursor_node *node;
+	u32 nr_chain = symbol_conf.use_callchain ? cursor->nr : 0;
+	size_t size = sizeof(*sample) + nr_chain * sizeof(sample->chain[0]);
+	u32 i;
+
+	size = ALIGN(size, sizeof(u64));
+	worker = &report_workers[hist_entry__hash(al, parent) %
+				 nr_report_workers];
+
+	if (worker->fill && worker->fill->size + size > REPORT_BATCH_SIZE)
+		report_worker__push(worker);
+
+	if (worker->fill == NULL) {
+		worker->fill = malloc(sizeof(*worker->fill));
+		if (worker->fill == NULL)
+			return -ENOMEM;
+		worker->fill->size = 0;
+	}
+
+	sample = (void *)worker->fill->data + worker->fill->size;
+	sample->evsel	 = evsel;
+	sample->al	 = *al;
+	sample->parent	 = parent;
+	sample->period	 = period;
+	sample->comm_len = thread__comm_len(al->thread);
+	sample->size	 = size;
+	sample->nr_chain = nr_chain;
+
+	for (i = 0, node = cursor->first; i < nr_chain; i++, node = node->next) {
+		sample->chain[i].ip  = node->ip;
+		sample->chain[i].map = node->map;
+		sample->chain[i].sym = node->sym;
+	}
+
+	worker->fill->size += size;
+	return 0;
+}
+
+static int report_workers__start(int nr)
+{
+	int i, err;
+
+	report_workers = zalloc(nr * sizeof(*report_workers));
+	if (report_workers == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		struct report_worker *worker = &report_workers[i];
+
+		pthread_mutex_init(&worker->lock, NULL);
+		pthread_cond_init(&worker->cond, NULL);
+		INIT_LIST_HEAD(&worker->queue);
+
+		err = pthread_create(&worker->thread, NULL,
+				     report_worker__thread, worker);
+		if (err) {
+			pr_err("Can't create report thread: %s\n",
+			       strerror(err));
+			break;
+		}
+		nr_report_workers++;
+	}
+
+	if (nr_report_workers == 0) {
+		free(report_workers);
+		report_workers = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int report_workers__stop(struct perf_evlist *evlist)
+{
+	struct perf_evsel *pos;
+	int i, err = 0;
+
+	for (i = 0; i < nr_report_workers; i++) {
+		struct report_worker *worker = &report_workers[i];
+
+		report_worker__push(worker);
+		pthread_mutex_lock(&worker->lock);
+		worker->done = true;
+		pthread_cond_broadcast(&worker->cond);
+		pthread_mutex_unlock(&worker->lock);
+	}
+
+	for (i = 0; i < nr_report_workers; i++) {
+		struct report_worker *worker = &report_workers[i];
+
+		pthread_join(worker->thread, NULL);
+		if (worker->err && !err)
+			err = worker->err;
+
+		list_for_each_entry(pos, &evlist->entries, node) {
+			if (pos->idx < worker->nr_hists)
+				hists__merge(&pos->hists,
+					     &worker->hists[pos->idx]);
+		}
+		free(worker->hists);
+	}
+
+	free(report_workers);
+	report_workers = NULL;
+	nr_report_workers = 0;
+
+	return err;
+}
+
 static int perf_session__add_hist_entry(struct perf_session *session,
 					struct addr_location *al,
 					struct perf_sample *sample,
@@ -64,6 +339,17 @@ static int perf_session__add_hist_entry(struct perf_session *session,
 			return err;
 	}
 
+	if (nr_report_workers) {
+		if (al->map)
+			al->map->referenced = true;
+
+		err = report_workers__queue(al, parent, sample->period, evsel,
+					    &session->callchain_cursor);
+		if (err)
+			return err;
+		goto out_stats;
+	}
+
 	he = __hists__add_entry(&evsel->hists, al, parent, sample->period);
 	if (he == NULL)
 		return -ENOMEM;
@@ -92,6 +378,7 @@ static int perf_session__add_hist_entry(struct perf_session *session,
 		err = hist_entry__inc_addr_samples(he, evsel->idx, al->addr);
 	}
 
+out_stats:
 	evsel->hists.stats.total_period += sample->period;
 	hists__inc_nr_events(&evsel->hists, PERF_RECORD_SAMPLE);
 out:
@@ -269,7 +556,16 @@ static int __cmd_report(void)
 	if (ret)
 		goto out_delete;
 
+	if (nr_report_jobs > 1 && report_workers__start(nr_report_jobs) < 0)
+		pr_warning("Processing the samples serially.\n");
+
 	ret = perf_session__process_events(session, &event_ops);
+	if (nr_report_workers) {
+		int err = report_workers__stop(session->evlist);
+
+		if (err && !ret)
+			ret = err;
+	}
 	if (ret)
 		goto out_delete;
 
@@ -455,6 +751,8 @@ static const struct option options[] = {
 		    "Only display entries resolved to a symbol"),
 	OPT_STRING(0, "symfs", &symbol_conf.symfs, "directory",
 		    "Look for files with symbols relative to this directory"),
+	OPT_INTEGER('j', "jobs", &nr_report_jobs,
+		    "number of threads building the histograms"),
 	OPT_END()
 };
 
@@ -471,6 +769,11 @@ int cmd_report(int argc, const char **argv, const char *prefix __used)
 		setup_browser(true);
 	else
 		use_browser = 0;
+
+	if (nr_report_jobs > 1 && use_browser > 0) {
+		pr_warning("--jobs is not supported with the TUI, ignoring it\n");
+		nr_report_jobs = 0;
+	}
 	/*
 	 * Only in the newt browser we are doing integrated annotation,
 	 * so don't allocate extra space that won't be used in the stdio
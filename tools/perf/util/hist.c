@@ -44,7 +44,8 @@ static void hists__reset_col_len(struct hists *self)
 		hists__set_col_len(self, col, 0);
 }
 
-static void hists__calc_col_len(struct hists *self, struct hist_entry *h)
+static void __hists__calc_col_len(struct hists *self, struct hist_entry *h,
+				  int comm_len)
 {
 	u16 len;
 
@@ -60,9 +61,8 @@ static void hists__calc_col_len(struct hists *self, struct hist_entry *h)
 					   unresolved_col_width);
 	}
 
-	len = thread__comm_len(h->thread);
-	if (hists__new_col_len(self, HISTC_COMM, len))
-		hists__set_col_len(self, HISTC_THREAD, len + 6);
+	if (hists__new_col_len(self, HISTC_COMM, comm_len))
+		hists__set_col_len(self, HISTC_THREAD, comm_len + 6);
 
 	if (h->ms.map) {
 		len = dso__name_len(h->ms.map->dso);
@@ -70,6 +70,11 @@ static void hists__calc_col_len(struct hists *self, struct hist_entry *h)
 	}
 }
 
+static void hists__calc_col_len(struct hists *self, struct hist_entry *h)
+{
+	__hists__calc_col_len(self, h, thread__comm_len(h->thread));
+}
+
 static void hist_entry__add_cpumode_period(struct hist_entry *self,
 					   unsigned int cpumode, u64 period)
 {
@@ -127,9 +132,11 @@ static u8 symbol__parent_filter(const struct symbol *parent)
 	return 0;
 }
 
-struct hist_entry *__hists__add_entry(struct hists *self,
-				      struct addr_location *al,
-				      struct symbol *sym_parent, u64 period)
+/* comm_len < 0 means the current comm length of the sample's thread */
+static struct hist_entry *hists__findnew_entry(struct hists *self,
+						struct addr_location *al,
+						struct symbol *sym_parent,
+						u64 period, int comm_len)
 {
 	struct rb_node **p = &self->entries.rb_node;
 	struct rb_node *parent = NULL;
@@ -184,12 +191,64 @@ struct hist_entry *__hists__add_entry(struct hists *self,
 		return NULL;
 	rb_link_node(&he->rb_node, parent, p);
 	rb_insert_color(&he->rb_node, &self->entries);
-	hists__inc_nr_entries(self, he);
+	if (comm_len < 0)
+		hists__inc_nr_entries(self, he);
+	else if (!he->filtered) {
+		__hists__calc_col_len(self, he, comm_len);
+		++self->nr_entries;
+	}
 out:
 	hist_entry__add_cpumode_period(he, al->cpumode, period);
 	return he;
 }
 
+struct hist_entry *__hists__add_entry(struct hists *self,
+				      struct addr_location *al,
+				      struct symbol *sym_parent, u64 period)
+{
+	return hists__findnew_entry(self, al, sym_parent, period, -1);
+}
+
+/*
+ * For the report worker threads: the thread comm may be changing under
+ * them, so the column widths of new entries are computed from the comm
+ * length the main thread saw when it queued the sample.  That is the
+ * length a serial run would have used, and hists__merge() keeps the
+ * widest of each column.
+ */
+struct hist_entry *__hists__add_private_entry(struct hists *self,
+					      struct addr_location *al,
+					      struct symbol *sym_parent,
+					      u64 period, int comm_len)
+{
+	return hists__findnew_entry(self, al, sym_parent, period, comm_len);
+}
+
+/*
+ * Entries that hist_entry__cmp() finds equal hash the same, so this can
+ * be used to always route them to the same private hists.
+ */
+u64 hist_entry__hash(struct addr_location *al, struct symbol *sym_parent)
+{
+	struct sort_entry *se;
+	struct hist_entry entry = {
+		.thread	= al->thread,
+		.ms = {
+			.map	= al->map,
+			.sym	= al->sym,
+		},
+		.cpu	= al->cpu,
+		.ip	= al->addr,
+		.parent = sym_parent,
+	};
+	u64 hash = 0;
+
+	list_for_each_entry(se, &hist_entry__sort_list, list)
+		hash = hash * 31 + se->se_hash(&entry);
+
+	return hash;
+}
+
 int64_t
 hist_entry__cmp(struct hist_entry *left, struct hist_entry *right)
 {
@@ -270,6 +329,72 @@ static bool hists__collapse_insert_entry(struct hists *self,
 	return true;
 }
 
+static bool hists__merge_insert_entry(struct hists *self,
+				      struct hist_entry *he)
+{
+	struct rb_node **p = &self->entries.rb_node;
+	struct rb_node *parent = NULL;
+	struct hist_entry *iter;
+	int64_t cmp;
+
+	while (*p != NULL) {
+		parent = *p;
+		iter = rb_entry(parent, struct hist_entry, rb_node);
+
+		cmp = hist_entry__cmp(he, iter);
+
+		if (!cmp) {
+			iter->period		+= he->period;
+			iter->period_sys	+= he->period_sys;
+			iter->period_us		+= he->period_us;
+			iter->period_guest_sys	+= he->period_guest_sys;
+			iter->period_guest_us	+= he->period_guest_us;
+			iter->nr_events		+= he->nr_events;
+			if (symbol_conf.use_callchain) {
+				callchain_cursor_reset(&self->callchain_cursor);
+				callchain_merge(&self->callchain_cursor, iter->callchain,
+						he->callchain);
+			}
+			hist_entry__free(he);
+			return false;
+		}
+
+		if (cmp < 0)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	rb_link_node(&he->rb_node, parent, p);
+	rb_insert_color(&he->rb_node, &self->entries);
+	return true;
+}
+
+/*
+ * Move all the entries of a private hists into self, which ends up the
+ * same as if they had been added there in the first place.
+ */
+void hists__merge(struct hists *self, struct hists *from)
+{
+	struct rb_node *next = rb_first(&from->entries);
+	struct hist_entry *n;
+	enum hist_column col;
+
+	while (next) {
+		n = rb_entry(next, struct hist_entry, rb_node);
+		next = rb_next(&n->rb_node);
+
+		rb_erase(&n->rb_node, &from->entries);
+		if (hists__merge_insert_entry(self, n) && !n->filtered)
+			++self->nr_entries;
+	}
+
+	for (col = 0; col < HISTC_NR_COLS; ++col)
+		hists__new_col_len(self, col, hists__col_len(from, col));
+
+	from->nr_entries = 0;
+}
+
 void hists__collapse_resort(struct hists *self)
 {
 	struct rb_root tmp;
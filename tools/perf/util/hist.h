@@ -55,6 +55,12 @@ struct hists {
 struct hist_entry *__hists__add_entry(struct hists *self,
 				      struct addr_location *al,
 				      struct symbol *parent, u64 period);
+struct hist_entry *__hists__add_private_entry(struct hists *self,
+					      struct addr_location *al,
+					      struct symbol *parent,
+					      u64 period, int comm_len);
+u64 hist_entry__hash(struct addr_location *al, struct symbol *parent);
+void hists__merge(struct hists *self, struct hists *from);
 extern int64_t hist_entry__cmp(struct hist_entry *, struct hist_entry *);
 extern int64_t hist_entry__collapse(struct hist_entry *, struct hist_entry *);
 int hist_entry__fprintf(struct hist_entry *self, struct hists *hists,
@@ -28,9 +28,16 @@ static int hist_entry__parent_snprintf(struct hist_entry *self, char *bf,
 static int hist_entry__cpu_snprintf(struct hist_entry *self, char *bf,
 				    size_t size, unsigned int width);
 
+static u64 sort__thread_hash(struct hist_entry *self);
+static u64 sort__dso_hash(struct hist_entry *self);
+static u64 sort__sym_hash(struct hist_entry *self);
+static u64 sort__parent_hash(struct hist_entry *self);
+static u64 sort__cpu_hash(struct hist_entry *self);
+
 struct sort_entry sort_thread = {
 	.se_header	= "Command:  Pid",
 	.se_cmp		= sort__thread_cmp,
+	.se_hash	= sort__thread_hash,
 	.se_snprintf	= hist_entry__thread_snprintf,
 	.se_width_idx	= HISTC_THREAD,
 };
@@ -39,6 +46,7 @@ struct sort_entry sort_comm = {
 	.se_header	= "Command",
 	.se_cmp		= sort__comm_cmp,
 	.se_collapse	= sort__comm_collapse,
+	.se_hash	= sort__thread_hash,
 	.se_snprintf	= hist_entry__comm_snprintf,
 	.se_width_idx	= HISTC_COMM,
 };
@@ -46,6 +54,7 @@ struct sort_entry sort_comm = {
 struct sort_entry sort_dso = {
 	.se_header	= "Shared Object",
 	.se_cmp		= sort__dso_cmp,
+	.se_hash	= sort__dso_hash,
 	.se_snprintf	= hist_entry__dso_snprintf,
 	.se_width_idx	= HISTC_DSO,
 };
@@ -53,6 +62,7 @@ struct sort_entry sort_dso = {
 struct sort_entry sort_sym = {
 	.se_header	= "Symbol",
 	.se_cmp		= sort__sym_cmp,
+	.se_hash	= sort__sym_hash,
 	.se_snprintf	= hist_entry__sym_snprintf,
 	.se_width_idx	= HISTC_SYMBOL,
 };
@@ -60,6 +70,7 @@ struct sort_entry sort_sym = {
 struct sort_entry sort_parent = {
 	.se_header	= "Parent symbol",
 	.se_cmp		= sort__parent_cmp,
+	.se_hash	= sort__parent_hash,
 	.se_snprintf	= hist_entry__parent_snprintf,
 	.se_width_idx	= HISTC_PARENT,
 };
@@ -67,6 +78,7 @@ struct sort_entry sort_parent = {
 struct sort_entry sort_cpu = {
 	.se_header      = "CPU",
 	.se_cmp	        = sort__cpu_cmp,
+	.se_hash	= sort__cpu_hash,
 	.se_snprintf    = hist_entry__cpu_snprintf,
 	.se_width_idx	= HISTC_CPU,
 };
@@ -96,6 +108,16 @@ int64_t cmp_null(void *l, void *r)
 		return 1;
 }
 
+static u64 str_hash(const char *str)
+{
+	u64 hash = 5381;
+
+	while (*str)
+		hash = hash * 33 + *str++;
+
+	return hash;
+}
+
 /* --sort pid */
 
 int64_t
@@ -104,6 +126,12 @@ sort__thread_cmp(struct hist_entry *left, struct hist_entry *right)
 	return right->thread->pid - left->thread->pid;
 }
 
+/* --sort comm compares the pid too, collapsing by name comes later */
+static u64 sort__thread_hash(struct hist_entry *self)
+{
+	return self->thread->pid;
+}
+
 static int repsep_snprintf(char *bf, size_t size, const char *fmt, ...)
 {
 	int n;
@@ -164,6 +192,16 @@ sort__dso_cmp(struct hist_entry *left, struct hist_entry *right)
 	return strcmp(dso_name_l, dso_name_r);
 }
 
+static u64 sort__dso_hash(struct hist_entry *self)
+{
+	struct dso *dso = self->ms.map ? self->ms.map->dso : NULL;
+
+	if (!dso)
+		return 0;
+
+	return str_hash(verbose ? dso->long_name : dso->short_name);
+}
+
 static int hist_entry__dso_snprintf(struct hist_entry *self, char *bf,
 				    size_t size, unsigned int width)
 {
@@ -181,15 +219,27 @@ static int hist_entry__dso_snprintf(struct hist_entry *self, char *bf,
 int64_t
 sort__sym_cmp(struct hist_entry *left, struct hist_entry *right)
 {
-	u64 ip_l, ip_r;
+	struct symbol *sym_l = left->ms.sym;
+	struct symbol *sym_r = right->ms.sym;
+
+	/*
+	 * Unresolved entries all compare equal.  Ordering them by ip against
+	 * the resolved ones would make which of them get merged depend on the
+	 * insertion order.
+	 */
+	if (!sym_l || !sym_r)
+		return cmp_null(sym_l, sym_r);
 
-	if (left->ms.sym == right->ms.sym)
+	if (sym_l == sym_r)
 		return 0;
 
-	ip_l = left->ms.sym ? left->ms.sym->start : left->ip;
-	ip_r = right->ms.sym ? right->ms.sym->start : right->ip;
+	return (int64_t)(sym_r->start - sym_l->start);
+}
 
-	return (int64_t)(ip_r - ip_l);
+/* all the unresolved entries compare equal, whatever their ip */
+static u64 sort__sym_hash(struct hist_entry *self)
+{
+	return self->ms.sym ? self->ms.sym->start : 0;
 }
 
 static int hist_entry__sym_snprintf(struct hist_entry *self, char *bf,
@@ -248,6 +298,11 @@ sort__parent_cmp(struct hist_entry *left, struct hist_entry *right)
 	return strcmp(sym_l->name, sym_r->name);
 }
 
+static u64 sort__parent_hash(struct hist_entry *self)
+{
+	return self->parent ? str_hash(self->parent->name) : 0;
+}
+
 static int hist_entry__parent_snprintf(struct hist_entry *self, char *bf,
 				       size_t size, unsigned int width)
 {
@@ -263,6 +318,11 @@ sort__cpu_cmp(struct hist_entry *left, struct hist_entry *right)
 	return right->cpu - left->cpu;
 }
 
+static u64 sort__cpu_hash(struct hist_entry *self)
+{
+	return self->cpu;
+}
+
 static int hist_entry__cpu_snprintf(struct hist_entry *self, char *bf,
 				       size_t size, unsigned int width)
 {
@@ -93,6 +93,8 @@ struct sort_entry {
 
 	int64_t (*se_cmp)(struct hist_entry *, struct hist_entry *);
 	int64_t (*se_collapse)(struct hist_entry *, struct hist_entry *);
+	/* equal for entries se_cmp finds equal, see hist_entry__hash() */
+	u64	(*se_hash)(struct hist_entry *);
 	int	(*se_snprintf)(struct hist_entry *self, char *bf, size_t size,
 			       unsigned int width);
 	u8	se_width_idx;
@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# First statfs and allocation on a nearly full loop-mounted vfat image.
+#
+# usage: fat-alloc-bench.sh [image size MB] [percent full]
+#
+# The image is filled with 64 MB files up to the given percentage and
+# remounted with cold caches.  Then the first and second statfs(), a
+# large sequential write and a batch of small files are timed; the
+# writes are synced, so their time includes the FAT updates.  Both
+# statfs() and the allocations used to read the FAT from the start, the
+# free cluster bitmap answers them from memory once it is built.
+#
+# Needs mkfs.vfat and root.  Set IMAGE to put the image on tmpfs, so
+# that the loop device does not add the backing storage to the figures.
+#
+
+SIZE=${1:-8192}
+FULL=${2:-90}
+IMAGE=${IMAGE:-/tmp/fat-alloc.img}
+MNT=${MNT:-/mnt/fat-alloc}
+WRITE=${WRITE:-256}
+SMALL=${SMALL:-1000}
+
+die ()
+{
+	echo "$*" >&2
+	exit 1
+}
+
+now ()
+{
+	date +%s.%N
+}
+
+# took <what> <start>
+took ()
+{
+	echo "$1: $(echo "$2 $(now)" | awk '{ printf "%.3f s", $2 - $1 }')"
+}
+
+[ "$(id -u)" = 0 ] || die "must be root"
+
+rm -f "$IMAGE"
+dd if=/dev/zero of="$IMAGE" bs=1M count=0 seek="$SIZE" 2>/dev/null ||
+	die "cannot create $IMAGE"
+mkfs.vfat -F 32 "$IMAGE" >/dev/null || die "mkfs.vfat failed"
+LOOP=$(losetup -f --show "$IMAGE") || die "no loop device"
+mkdir -p "$MNT"
+mount -t vfat "$LOOP" "$MNT" || die "mount failed"
+
+echo "filling $FULL% of $SIZE MB"
+n=0
+while [ $((n * 64)) -lt $((SIZE * FULL / 100)) ]; do
+	dd if=/dev/zero of="$MNT/fill$n" bs=1M count=64 2>/dev/null ||
+		die "fill failed"
+	n=$((n + 1))
+done
+
+umount "$MNT"
+echo 3 > /proc/sys/vm/drop_caches
+mount -t vfat "$LOOP" "$MNT" || die "remount failed"
+
+T=$(now)
+stat -f "$MNT" >/dev/null
+took "first statfs" $T
+T=$(now)
+stat -f "$MNT" >/dev/null
+took "second statfs" $T
+
+T=$(now)
+dd if=/dev/zero of="$MNT/write" bs=1M count="$WRITE" conv=fsync 2>/dev/null
+took "write $WRITE MB" $T
+
+mkdir "$MNT/small"
+T=$(now)
+i=0
+while [ $i -lt "$SMALL" ]; do
+	dd if=/dev/zero of="$MNT/small/$i" bs=4k count=1 2>/dev/null
+	i=$((i + 1))
+done
+sync
+took "create $SMALL 4 KB files" $T
+
+umount "$MNT"
+losetup -d "$LOOP"
+rm -f "$IMAGE"
@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# Random reads in a large fragmented file on a loop-mounted vfat image.
+#
+# usage: fat-seek-bench.sh [image size MB] [file size MB] [fragment KB]
+#
+# The image is filled with files of one fragment each, every other one
+# is deleted, and the big file is written into the holes, so it ends up
+# in runs of about one fragment.  After a remount the file is read at
+# random offsets with O_DIRECT, so that every read maps its offset
+# through fat_get_cluster().  randread (built from randread.c in this
+# directory, next to this script) reports the time per read for a cold
+# and a warm pass over the same offsets.
+#
+# Needs mkfs.vfat and root.  Set IMAGE to put the image on tmpfs, so
+# that the loop device does not add the backing storage to the figures.
+#
+
+SIZE=${1:-8192}
+FILE=${2:-3072}
+FRAG=${3:-256}
+IMAGE=${IMAGE:-/tmp/fat-seek.img}
+MNT=${MNT:-/mnt/fat-seek}
+READS=${READS:-5000}
+RANDREAD=$(dirname "$0")/randread
+
+die ()
+{
+	echo "$*" >&2
+	exit 1
+}
+
+[ "$(id -u)" = 0 ] || die "must be root"
+[ -x "$RANDREAD" ] || die "build $RANDREAD first"
+
+rm -f "$IMAGE"
+dd if=/dev/zero of="$IMAGE" bs=1M count=0 seek="$SIZE" 2>/dev/null ||
+	die "cannot create $IMAGE"
+mkfs.vfat -F 32 "$IMAGE" >/dev/null || die "mkfs.vfat failed"
+LOOP=$(losetup -f --show "$IMAGE") || die "no loop device"
+mkdir -p "$MNT"
+mount -t vfat "$LOOP" "$MNT" || die "mount failed"
+
+echo "filling $SIZE MB with $FRAG KB files"
+n=0
+while :; do
+	d=$MNT/fill/$((n / 1000))
+	mkdir -p "$d" 2>/dev/null
+	dd if=/dev/zero of="$d/$n" bs=${FRAG}k count=1 2>/dev/null || break
+	n=$((n + 1))
+done
+i=1
+while [ $i -lt $n ]; do
+	rm -f "$MNT/fill/$((i / 1000))/$i"
+	i=$((i + 2))
+done
+
+echo "writing a $FILE MB file into the holes"
+dd if=/dev/zero of="$MNT/big" bs=1M count="$FILE" 2>/dev/null
+sync
+FILE=$(($(stat -c %s "$MNT/big") >> 20))
+echo "file is $FILE MB in about $((FILE * 1024 / FRAG)) runs"
+
+umount "$MNT"
+echo 3 > /proc/sys/vm/drop_caches
+mount -t vfat "$LOOP" "$MNT" || die "remount failed"
+
+"$RANDREAD" -n "$READS" "$MNT/big"
+
+umount "$MNT"
+losetup -d "$LOOP"
+rm -f "$IMAGE"
@@ -0,0 +1,107 @@
+/* $(CROSS_COMPILE)cc -Wall -Wextra -O2 -o randread randread.c */
+
+/*
+ * Random O_DIRECT reads from one file, timed.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ * Every read bypasses the page cache, so each one maps its file offset to
+ * a disk block through the filesystem's get_block.  The same offsets are
+ * read twice: the first pass finds whatever the filesystem caches about
+ * the file's layout cold, the second one warm.
+ *
+ * usage: randread [-n reads] [-s size] file
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int pass(int fd, const off_t *offs, int n, void *buf, size_t size,
+		const char *name)
+{
+	double start = now(), t;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (pread(fd, buf, size, offs[i]) != (ssize_t)size) {
+			fprintf(stderr, "read at %lld: %s\n",
+				(long long)offs[i], strerror(errno));
+			return -1;
+		}
+	}
+	t = now() - start;
+	printf("%s: %d reads of %zu bytes in %.3f s, %.1f us per read\n",
+	       name, n, size, t, t * 1e6 / n);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t size = 4096;
+	int n = 10000;
+	struct stat st;
+	off_t *offs, blocks;
+	void *buf;
+	int fd, c, i;
+
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || n <= 0 || !size || size % 512)
+		goto usage;
+
+	fd = open(argv[optind], O_RDONLY | O_DIRECT);
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	blocks = st.st_size / size;
+	if (!blocks) {
+		fprintf(stderr, "%s: shorter than one read\n", argv[optind]);
+		return 1;
+	}
+
+	offs = malloc(n * sizeof(*offs));
+	if (!offs || posix_memalign(&buf, 4096, size)) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	srand(1);
+	for (i = 0; i < n; i++)
+		offs[i] = (((off_t)rand() << 31 | rand()) % blocks) * size;
+
+	if (pass(fd, offs, n, buf, size, "cold") ||
+	    pass(fd, offs, n, buf, size, "warm"))
+		return 1;
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n reads] [-s size] file\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Read throughput of a loop-mounted squashfs image, one reader against
+# several, with threads=single and threads=multi.
+#
+# usage: squashfs-read-bench.sh [readers] [file size MB] [compressor]
+#
+# One compressible file per reader is packed into an image.  For each
+# mount mode the image is mounted with cold caches and the files are
+# read first one after the other, then all at once, one reader each.
+# With threads=single the parallel readers still decompress one block
+# at a time, so only threads=multi should scale with the CPUs.
+#
+# Needs mksquashfs and root.  Set DIR to put the image on tmpfs, so
+# that the loop device does not add the backing storage to the figures.
+#
+
+READERS=${1:-$(grep -c ^processor /proc/cpuinfo)}
+FILE=${2:-64}
+COMP=${3:-gzip}
+DIR=${DIR:-/tmp/squashfs-bench}
+MNT=${MNT:-/mnt/squashfs-bench}
+
+die ()
+{
+	echo "$*" >&2
+	exit 1
+}
+
+now ()
+{
+	date +%s.%N
+}
+
+# rate <what> <MB> <start>
+rate ()
+{
+	echo "$1: $(echo "$2 $3 $(now)" |
+		awk '{ t = $3 - $2; printf "%.2f s, %.1f MB/s", t, $1 / t }')"
+}
+
+[ "$(id -u)" = 0 ] || die "must be root"
+
+rm -rf "$DIR"
+mkdir -p "$DIR/src" "$MNT" || die "cannot create $DIR"
+i=0
+while [ $i -lt "$READERS" ]; do
+	# base64 of random data compresses to about 3/4
+	head -c $((FILE * 1024 * 768)) /dev/urandom | base64 > "$DIR/src/$i"
+	i=$((i + 1))
+done
+mksquashfs "$DIR/src" "$DIR/image" -comp "$COMP" -noappend >/dev/null ||
+	die "mksquashfs failed"
+LOOP=$(losetup -f --show "$DIR/image") || die "no loop device"
+TOTAL=$(du -sm "$DIR/src" | cut -f1)
+
+echo "$READERS files, $TOTAL MB uncompressed, $COMP"
+for mode in single multi; do
+	mount -t squashfs -o ro,threads=$mode "$LOOP" "$MNT" ||
+		die "mount threads=$mode failed"
+
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	T=$(now)
+	cat "$MNT"/* > /dev/null
+	rate "threads=$mode 1 reader" $TOTAL $T
+
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	T=$(now)
+	for f in "$MNT"/*; do
+		cat "$f" > /dev/null &
+	done
+	wait
+	rate "threads=$mode $READERS readers" $TOTAL $T
+
+	umount "$MNT"
+done
+
+losetup -d "$LOOP"
+rm -rf "$DIR"
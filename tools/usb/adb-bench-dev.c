@@ -0,0 +1,119 @@
+/*
+ * adb-bench-dev.c -- gadget side of the adb throughput test
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Moves raw data between a file and /dev/android_adb, the way adbd does
+ * for push and pull but without the adb protocol, either with read() and
+ * write() through a buffer or with splice() through a pipe.  adb-bench.py
+ * is the other end on the host and does the timing.
+ *
+ * usage: adb-bench-dev push|pull rw|splice <size MB> <file>
+ *
+ * push receives from the host into the file, pull sends the file.
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o adb-bench-dev adb-bench-dev.c */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* adb_read() takes at most one bulk buffer */
+#define ADB_BUFLEN	4096
+
+static int copy_rw(int in, int out, long long len, size_t chunk)
+{
+	static char buf[65536];
+	ssize_t n, w;
+
+	while (len > 0) {
+		n = read(in, buf, len < (long long)chunk ? (size_t)len : chunk);
+		if (n <= 0)
+			return n ? -1 : 0;
+		for (w = 0; w < n; ) {
+			ssize_t r = write(out, buf + w, n - w);
+
+			if (r < 0)
+				return -1;
+			w += r;
+		}
+		len -= n;
+	}
+	return 0;
+}
+
+static int copy_splice(int in, int out, long long len, size_t chunk)
+{
+	int pipefd[2];
+	ssize_t n, w;
+
+	if (pipe(pipefd))
+		return -1;
+	while (len > 0) {
+		n = splice(in, NULL, pipefd[1], NULL,
+			   len < (long long)chunk ? (size_t)len : chunk, SPLICE_F_MOVE);
+		if (n <= 0)
+			return n ? -1 : 0;
+		for (w = 0; w < n; ) {
+			ssize_t r = splice(pipefd[0], NULL, out, NULL, n - w,
+					   SPLICE_F_MOVE);
+
+			if (r <= 0)
+				return -1;
+			w += r;
+		}
+		len -= n;
+	}
+	close(pipefd[0]);
+	close(pipefd[1]);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int adb, file, push, ret;
+	long long len;
+	size_t chunk;
+
+	if (argc != 5 || (strcmp(argv[1], "push") && strcmp(argv[1], "pull")) ||
+	    (strcmp(argv[2], "rw") && strcmp(argv[2], "splice"))) {
+		fprintf(stderr, "usage: %s push|pull rw|splice <size MB> <file>\n",
+			argv[0]);
+		return 1;
+	}
+	push = !strcmp(argv[1], "push");
+	len = atoll(argv[3]) << 20;
+
+	adb = open("/dev/android_adb", O_RDWR);
+	if (adb < 0) {
+		perror("/dev/android_adb");
+		return 1;
+	}
+	file = push ? open(argv[4], O_WRONLY | O_CREAT | O_TRUNC, 0644)
+		    : open(argv[4], O_RDONLY);
+	if (file < 0) {
+		perror(argv[4]);
+		return 1;
+	}
+
+	chunk = push ? ADB_BUFLEN : 65536;
+	if (!strcmp(argv[2], "rw"))
+		ret = push ? copy_rw(adb, file, len, chunk)
+			   : copy_rw(file, adb, len, chunk);
+	else
+		ret = push ? copy_splice(adb, file, len, chunk)
+			   : copy_splice(file, adb, len, chunk);
+	if (ret) {
+		perror(argv[1]);
+		return 1;
+	}
+	return 0;
+}
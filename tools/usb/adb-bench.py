@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+#
+# adb-bench.py -- host side of the adb throughput test
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+#
+# Sends raw data to, or reads it from, the bulk endpoints of the gadget's
+# adb interface, with adb-bench-dev on the other end, and prints the time
+# and MB/s of the transfer.  No adb server may hold the interface while
+# this runs.  Needs pyusb.
+#
+# usage: adb-bench.py [-v vid] [-p pid] [-s size MB] push|pull
+#
+
+from __future__ import print_function
+
+import getopt
+import sys
+import time
+
+import usb.core
+import usb.util
+
+ADB_CLASS, ADB_SUBCLASS, ADB_PROTOCOL = 0xff, 0x42, 1
+CHUNK = 1 << 20
+TIMEOUT = 10000
+
+
+def adb_endpoints(vid, pid):
+    # the gadget only connects once adb-bench-dev has opened its end
+    for i in range(100):
+        dev = usb.core.find(idVendor=vid, idProduct=pid)
+        if dev is not None:
+            break
+        time.sleep(0.1)
+    else:
+        sys.exit('no device %04x:%04x' % (vid, pid))
+    for intf in dev.get_active_configuration():
+        if intf.bInterfaceClass == ADB_CLASS and \
+           intf.bInterfaceSubClass == ADB_SUBCLASS and \
+           intf.bInterfaceProtocol == ADB_PROTOCOL:
+            break
+    else:
+        sys.exit('no adb interface')
+    if dev.is_kernel_driver_active(intf.bInterfaceNumber):
+        dev.detach_kernel_driver(intf.bInterfaceNumber)
+    usb.util.claim_interface(dev, intf)
+
+    def bulk(direction):
+        return usb.util.find_descriptor(intf, custom_match=lambda e:
+            usb.util.endpoint_type(e.bmAttributes) ==
+                usb.util.ENDPOINT_TYPE_BULK and
+            usb.util.endpoint_direction(e.bEndpointAddress) == direction)
+    return bulk(usb.util.ENDPOINT_IN), bulk(usb.util.ENDPOINT_OUT)
+
+
+def main():
+    vid, pid, size = 0x18d1, 0x4ee7, 64
+    opts, args = getopt.getopt(sys.argv[1:], 'v:p:s:')
+    for opt, val in opts:
+        if opt == '-v':
+            vid = int(val, 16)
+        elif opt == '-p':
+            pid = int(val, 16)
+        elif opt == '-s':
+            size = int(val)
+    if len(args) != 1 or args[0] not in ('push', 'pull'):
+        sys.exit('usage: %s [-v vid] [-p pid] [-s size MB] push|pull' %
+                 sys.argv[0])
+    size <<= 20
+
+    ep_in, ep_out = adb_endpoints(vid, pid)
+    data = bytearray(CHUNK)
+    start = time.time()
+    left = size
+    while left > 0:
+        if args[0] == 'push':
+            left -= ep_out.write(data[:min(left, CHUNK)], TIMEOUT)
+        else:
+            left -= len(ep_in.read(min(left, CHUNK), TIMEOUT))
+    t = time.time() - start
+    print('%-4s %d MB: %.2f s, %.1f MB/s' %
+          (args[0], size >> 20, t, (size >> 20) / t))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# adb gadget push and pull throughput, with the host and the gadget on
+# one machine through dummy_hcd.
+#
+# Needs a kernel with USB_GADGET_DUMMY_HCD and USB_G_ANDROID, pyusb for
+# the host side, and adb-bench-dev built next to this script.  Neither
+# adbd nor a host adb server may be running.  The adb function keeps the
+# gadget off the bus while /dev/android_adb is closed, so it reconnects
+# for every run and the host side waits for it.  Each direction is timed
+# with read()/write() through a buffer, the way adbd moves file data,
+# and with splice() between the file and /dev/android_adb:
+#
+#	push:	host -> /dev/android_adb -> file
+#	pull:	file -> /dev/android_adb -> host
+#
+# usage: adb-bench.sh [size in MB] [directory for the files]
+#
+
+SIZE=${1:-64}
+DIR=${2:-/tmp}
+HERE=$(dirname "$0")
+GADGET=/sys/class/android_usb/android0
+VID=18d1
+PID=4ee7
+
+die ()
+{
+	echo "$*" >&2
+	exit 1
+}
+
+[ "$(id -u)" = 0 ] || die "must be root"
+[ -d $GADGET ] || die "no android gadget"
+[ -x "$HERE/adb-bench-dev" ] || die "build $HERE/adb-bench-dev first"
+
+dd if=/dev/urandom of="$DIR/adb-bench.src" bs=1M count="$SIZE" 2>/dev/null ||
+	die "cannot create $DIR/adb-bench.src"
+
+echo 0 > $GADGET/enable
+echo $VID > $GADGET/idVendor
+echo $PID > $GADGET/idProduct
+echo adb > $GADGET/functions
+echo 1 > $GADGET/enable
+
+# run <push|pull> <rw|splice> <file>
+run ()
+{
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	"$HERE/adb-bench-dev" $1 $2 "$SIZE" "$3" &
+	DEV=$!
+	echo -n "$2: "
+	python "$HERE/adb-bench.py" -v $VID -p $PID -s "$SIZE" $1
+	wait $DEV || echo "$2: adb-bench-dev $1 failed"
+}
+
+for mode in rw splice; do
+	run push $mode "$DIR/adb-bench.dst"
+	# the host sends zeros
+	cmp -s -n $((SIZE << 20)) "$DIR/adb-bench.dst" /dev/zero ||
+		echo "$mode: received file differs"
+	run pull $mode "$DIR/adb-bench.src"
+done
+
+echo 0 > $GADGET/enable
+rm -f "$DIR/adb-bench.src" "$DIR/adb-bench.dst"
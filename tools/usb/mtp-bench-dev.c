@@ -0,0 +1,182 @@
+/*
+ * mtp-bench-dev.c -- gadget side of the MTP throughput test
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Answers just enough of MTP on /dev/mtp_usb for mtp-bench.py: sessions,
+ * GetObject, which sends the given file with MTP_SEND_FILE_WITH_HEADER,
+ * and SendObject, which receives into the given output file with
+ * MTP_RECEIVE_FILE.  That is the same path the Android MTP server takes
+ * for file transfers, without its object database.
+ *
+ * usage: mtp-bench-dev <file to send> <file to receive into>
+ */
+
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o mtp-bench-dev mtp-bench-dev.c */
+
+#define _GNU_SOURCE
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../../include/linux/usb/f_mtp.h"
+
+#define MTP_CONTAINER_COMMAND	1
+#define MTP_CONTAINER_DATA	2
+#define MTP_CONTAINER_RESPONSE	3
+
+#define MTP_OPEN_SESSION	0x1002
+#define MTP_CLOSE_SESSION	0x1003
+#define MTP_GET_OBJECT		0x1009
+#define MTP_SEND_OBJECT		0x100D
+
+#define MTP_RESPONSE_OK		0x2001
+#define MTP_RESPONSE_GENERAL_ERROR	0x2002
+#define MTP_RESPONSE_NOT_SUPPORTED	0x2005
+
+struct mtp_container {
+	uint32_t length;
+	uint16_t type;
+	uint16_t code;
+	uint32_t transaction_id;
+	uint32_t params[5];
+} __attribute__((packed));
+
+static int respond(int fd, uint16_t code, uint32_t tid)
+{
+	struct mtp_container c = {
+		.length = htole32(12),
+		.type = htole16(MTP_CONTAINER_RESPONSE),
+		.code = htole16(code),
+		.transaction_id = htole32(tid),
+	};
+
+	if (write(fd, &c, 12) != 12) {
+		perror("response");
+		return -1;
+	}
+	return 0;
+}
+
+static uint16_t get_object(int fd, const char *path, uint32_t tid)
+{
+	struct mtp_file_range range;
+	struct stat st;
+	int file;
+
+	file = open(path, O_RDONLY);
+	if (file < 0 || fstat(file, &st)) {
+		perror(path);
+		return MTP_RESPONSE_GENERAL_ERROR;
+	}
+
+	memset(&range, 0, sizeof(range));
+	range.fd = file;
+	range.offset = 0;
+	range.length = st.st_size;
+	range.command = MTP_GET_OBJECT;
+	range.transaction_id = tid;
+	if (ioctl(fd, MTP_SEND_FILE_WITH_HEADER, &range)) {
+		perror("MTP_SEND_FILE_WITH_HEADER");
+		close(file);
+		return MTP_RESPONSE_GENERAL_ERROR;
+	}
+	close(file);
+	return MTP_RESPONSE_OK;
+}
+
+/* The host sends the data container header on its own, then the data */
+static uint16_t send_object(int fd, const char *path)
+{
+	struct mtp_container c;
+	struct mtp_file_range range;
+	int file;
+
+	if (read(fd, &c, sizeof(c)) != 12 ||
+	    le16toh(c.type) != MTP_CONTAINER_DATA) {
+		fprintf(stderr, "bad data container\n");
+		return MTP_RESPONSE_GENERAL_ERROR;
+	}
+
+	file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file < 0) {
+		perror(path);
+		return MTP_RESPONSE_GENERAL_ERROR;
+	}
+
+	memset(&range, 0, sizeof(range));
+	range.fd = file;
+	range.offset = 0;
+	range.length = le32toh(c.length) - 12;
+	if (ioctl(fd, MTP_RECEIVE_FILE, &range)) {
+		perror("MTP_RECEIVE_FILE");
+		close(file);
+		return MTP_RESPONSE_GENERAL_ERROR;
+	}
+	close(file);
+	return MTP_RESPONSE_OK;
+}
+
+int main(int argc, char **argv)
+{
+	struct mtp_container c;
+	uint32_t tid;
+	uint16_t code, ret;
+	int fd, n;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s <file to send> <file to receive into>\n",
+			argv[0]);
+		return 1;
+	}
+
+	fd = open("/dev/mtp_usb", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/mtp_usb");
+		return 1;
+	}
+
+	for (;;) {
+		n = read(fd, &c, sizeof(c));
+		if (n < 0 && errno == ECANCELED)
+			continue;
+		if (n < 0) {
+			perror("read");
+			return 1;
+		}
+		if (n < 12 || le16toh(c.type) != MTP_CONTAINER_COMMAND)
+			continue;
+
+		code = le16toh(c.code);
+		tid = le32toh(c.transaction_id);
+		switch (code) {
+		case MTP_OPEN_SESSION:
+		case MTP_CLOSE_SESSION:
+			ret = MTP_RESPONSE_OK;
+			break;
+		case MTP_GET_OBJECT:
+			ret = get_object(fd, argv[1], tid);
+			break;
+		case MTP_SEND_OBJECT:
+			ret = send_object(fd, argv[2]);
+			break;
+		default:
+			ret = MTP_RESPONSE_NOT_SUPPORTED;
+			break;
+		}
+		if (respond(fd, ret, tid))
+			return 1;
+		if (code == MTP_CLOSE_SESSION)
+			return 0;
+	}
+}
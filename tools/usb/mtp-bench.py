@@ -0,0 +1,127 @@
+#!/usr/bin/env python
+#
+# mtp-bench.py -- host side of the MTP throughput test
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+#
+# Talks MTP containers over the bulk endpoints of the gadget's MTP
+# interface, with mtp-bench-dev answering on the gadget side: it opens a
+# session, then times SendObject (host to device) and GetObject (device
+# to host) of a file of the given size a few rounds each, and prints MB/s
+# for each round.  Only the first GetObject round reads the file cold.
+# Needs pyusb.
+#
+# usage: mtp-bench.py [-v vid] [-p pid] [-s size MB] [-r rounds]
+#
+
+from __future__ import print_function
+
+import getopt
+import struct
+import sys
+import time
+
+import usb.core
+import usb.util
+
+COMMAND, DATA, RESPONSE = 1, 2, 3
+OPEN_SESSION, CLOSE_SESSION = 0x1002, 0x1003
+GET_OBJECT, SEND_OBJECT = 0x1009, 0x100D
+RESPONSE_OK = 0x2001
+CHUNK = 1 << 20
+TIMEOUT = 10000
+
+
+class Mtp(object):
+    def __init__(self, vid, pid):
+        self.dev = usb.core.find(idVendor=vid, idProduct=pid)
+        if self.dev is None:
+            sys.exit('no device %04x:%04x' % (vid, pid))
+        for intf in self.dev.get_active_configuration():
+            if intf.bInterfaceClass in (6, 0xff) and \
+               intf.bInterfaceSubClass in (1, 0xff) and \
+               intf.bNumEndpoints == 3:
+                break
+        else:
+            sys.exit('no MTP interface')
+        if self.dev.is_kernel_driver_active(intf.bInterfaceNumber):
+            self.dev.detach_kernel_driver(intf.bInterfaceNumber)
+        usb.util.claim_interface(self.dev, intf)
+
+        def bulk(direction):
+            return usb.util.find_descriptor(intf, custom_match=lambda e:
+                usb.util.endpoint_type(e.bmAttributes) ==
+                    usb.util.ENDPOINT_TYPE_BULK and
+                usb.util.endpoint_direction(e.bEndpointAddress) == direction)
+        self.ep_in = bulk(usb.util.ENDPOINT_IN)
+        self.ep_out = bulk(usb.util.ENDPOINT_OUT)
+        self.tid = 0
+
+    def command(self, code, *params):
+        self.tid += 1
+        self.ep_out.write(struct.pack('<IHHI%dI' % len(params),
+                                      12 + 4 * len(params), COMMAND, code,
+                                      self.tid, *params), TIMEOUT)
+
+    def response(self):
+        while True:
+            buf = self.ep_in.read(512, TIMEOUT)
+            # a zero length packet can end the data phase before it
+            if len(buf):
+                break
+        length, type, code, tid = struct.unpack('<IHHI', buf[:12])
+        if type != RESPONSE or code != RESPONSE_OK:
+            sys.exit('operation failed: %04x' % code)
+
+    def get_object(self, size):
+        self.command(GET_OBJECT, 1)
+        left = 12 + size
+        while left > 0:
+            left -= len(self.ep_in.read(min(left, CHUNK), TIMEOUT))
+        self.response()
+
+    def send_object(self, data):
+        self.command(SEND_OBJECT)
+        self.ep_out.write(struct.pack('<IHHI', 12 + len(data), DATA,
+                                      SEND_OBJECT, self.tid), TIMEOUT)
+        for off in range(0, len(data), CHUNK):
+            self.ep_out.write(data[off:off + CHUNK], TIMEOUT)
+        self.response()
+
+
+def main():
+    vid, pid, size, rounds = 0x18d1, 0x4ee1, 64, 3
+    opts, args = getopt.getopt(sys.argv[1:], 'v:p:s:r:')
+    for opt, val in opts:
+        if opt == '-v':
+            vid = int(val, 16)
+        elif opt == '-p':
+            pid = int(val, 16)
+        elif opt == '-s':
+            size = int(val)
+        elif opt == '-r':
+            rounds = int(val)
+    size <<= 20
+
+    mtp = Mtp(vid, pid)
+    mtp.command(OPEN_SESSION, 1)
+    mtp.response()
+
+    data = bytearray(size)
+    for name, op in (('send', lambda: mtp.send_object(data)),
+                     ('get', lambda: mtp.get_object(size))):
+        for i in range(rounds):
+            start = time.time()
+            op()
+            t = time.time() - start
+            print('%-4s %d MB, round %d: %.2f s, %.1f MB/s' %
+                  (name, size >> 20, i + 1, t, (size >> 20) / t))
+
+    mtp.command(CLOSE_SESSION)
+    mtp.response()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# MTP gadget throughput, with the host and the gadget on one machine
+# through dummy_hcd.
+#
+# Needs a kernel with USB_GADGET_DUMMY_HCD and USB_G_ANDROID, pyusb for
+# the host side, and mtp-bench-dev built next to this script.  The MTP
+# function reads its request settings when it is bound, so each setting
+# is applied with the gadget disabled and then timed:
+#
+#	old:	4 IN and 2 OUT requests of 16 KB, as before
+#	new:	the defaults of the running kernel
+#
+# usage: mtp-bench.sh [size in MB] [directory for the files]
+#
+
+SIZE=${1:-64}
+DIR=${2:-/tmp}
+HERE=$(dirname "$0")
+GADGET=/sys/class/android_usb/android0
+PARAMS=/sys/module/g_android/parameters
+VID=18d1
+PID=4ee1
+
+die ()
+{
+	echo "$*" >&2
+	exit 1
+}
+
+[ "$(id -u)" = 0 ] || die "must be root"
+[ -d $GADGET ] || die "no android gadget"
+[ -x "$HERE/mtp-bench-dev" ] || die "build $HERE/mtp-bench-dev first"
+
+dd if=/dev/urandom of="$DIR/mtp-bench.src" bs=1M count="$SIZE" 2>/dev/null ||
+	die "cannot create $DIR/mtp-bench.src"
+
+DEFAULTS="$(cat $PARAMS/mtp_tx_reqs) $(cat $PARAMS/mtp_rx_reqs)"
+DEFAULTS="$DEFAULTS $(cat $PARAMS/mtp_tx_req_len) $(cat $PARAMS/mtp_rx_req_len)"
+
+# run <name> <tx reqs> <rx reqs> <tx len> <rx len>
+run ()
+{
+	echo 0 > $GADGET/enable
+	echo $2 > $PARAMS/mtp_tx_reqs
+	echo $3 > $PARAMS/mtp_rx_reqs
+	echo $4 > $PARAMS/mtp_tx_req_len
+	echo $5 > $PARAMS/mtp_rx_req_len
+	echo $VID > $GADGET/idVendor
+	echo $PID > $GADGET/idProduct
+	echo mtp > $GADGET/functions
+	echo 1 > $GADGET/enable
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+	sleep 2
+
+	"$HERE/mtp-bench-dev" "$DIR/mtp-bench.src" "$DIR/mtp-bench.dst" &
+	DEV=$!
+	echo "$1: $2 IN x $4 bytes, $3 OUT x $5 bytes"
+	python "$HERE/mtp-bench.py" -v $VID -p $PID -s "$SIZE"
+	wait $DEV
+	# the host sends zeros
+	cmp -s -n $((SIZE << 20)) "$DIR/mtp-bench.dst" /dev/zero ||
+		echo "$1: received file differs"
+}
+
+run old 4 2 16384 16384
+run new $DEFAULTS
+
+echo 0 > $GADGET/enable
+rm -f "$DIR/mtp-bench.src" "$DIR/mtp-bench.dst"
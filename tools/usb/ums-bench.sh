@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# Mass storage gadget throughput, with the host and the gadget on one
+# machine through dummy_hcd.
+#
+# Needs a kernel with USB_GADGET_DUMMY_HCD, USB_MASS_STORAGE (g_mass_storage)
+# and usb-storage, all as modules.  The buffer count and size are Kconfig
+# options (USB_GADGET_STORAGE_NUM_BUFFERS, USB_GADGET_STORAGE_BUFLEN), so
+# comparing two settings means running this on two builds.
+#
+# usage: ums-bench.sh [image] [size in MB]
+#
+# The image is the backing file of the gadget and is overwritten.  The
+# host writes the whole disk, then reads it back, both with O_DIRECT so
+# only the gadget side caches.  The eject is timed too, since that is
+# where the gadget flushes what it left in its page cache.
+#
+
+IMAGE=${1:-/tmp/ums-bench.img}
+SIZE=${2:-256}
+
+die ()
+{
+	echo "$*" >&2
+	exit 1
+}
+
+now ()
+{
+	date +%s.%N
+}
+
+# rate <MB> <start> <end>
+rate ()
+{
+	echo "$1 $2 $3" | awk '{ t = $3 - $2; printf "%.2f s, %.1f MB/s\n", t, $1 / t }'
+}
+
+[ "$(id -u)" = 0 ] || die "must be root"
+
+rm -f "$IMAGE"
+dd if=/dev/zero of="$IMAGE" bs=1M count=0 seek="$SIZE" 2>/dev/null ||
+	die "cannot create $IMAGE"
+
+modprobe dummy_hcd || die "no dummy_hcd"
+modprobe usb-storage
+modprobe g_mass_storage file="$IMAGE" removable=1 stall=0 ||
+	die "no g_mass_storage"
+
+# Wait for the host side disk
+DISK=
+for i in $(seq 30); do
+	for d in /sys/block/sd*; do
+		grep -q "File-Stor" $d/device/model 2>/dev/null &&
+			DISK=/dev/${d##*/}
+	done
+	[ -n "$DISK" ] && break
+	sleep 1
+done
+[ -n "$DISK" ] || die "gadget disk did not show up"
+LUN=$(find /sys/devices -path '*gadget/lun0/file' | head -n 1)
+
+echo "disk $DISK, $SIZE MB, backing file $IMAGE"
+
+sync
+echo 3 > /proc/sys/vm/drop_caches
+T0=$(now)
+dd if=/dev/zero of="$DISK" bs=1M count="$SIZE" oflag=direct 2>/dev/null ||
+	die "write failed"
+T1=$(now)
+echo "write: $(rate $SIZE $T0 $T1)"
+
+sync
+echo 3 > /proc/sys/vm/drop_caches
+T0=$(now)
+dd if="$DISK" of=/dev/null bs=1M count="$SIZE" iflag=direct 2>/dev/null ||
+	die "read failed"
+T1=$(now)
+echo "read:  $(rate $SIZE $T0 $T1)"
+
+# Rewrite, then eject from the gadget side without syncing first
+dd if=/dev/zero of="$DISK" bs=1M count="$SIZE" oflag=direct 2>/dev/null
+T0=$(now)
+[ -n "$LUN" ] && echo > "$LUN"
+T1=$(now)
+echo "eject: $(echo "$T0 $T1" | awk '{ printf "%.2f s", $2 - $1 }')"
+
+rmmod g_mass_storage
+rmmod dummy_hcd
+rm -f "$IMAGE"